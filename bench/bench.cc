@@ -0,0 +1,290 @@
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include <sys/resource.h>
+
+#include "alloc_profiler.hh"
+#include "parser.hh"
+#include "tableau.hh"
+
+/*
+  Microbenchmarks of the parser, the rendering, the substitution and the
+  solver
+
+  Every benchmark has an untimed setup and a timed operation, run once per
+  iteration. Iterations are added until the timed part reaches the minimum
+  time. Then the whole measure is repeated, and the fastest repetition is
+  reported, which is the most repeatable figure on a noisy machine.
+
+  Allocations are counted by AllocationProfiler (through the operator new
+  of profiled_new.cc), only around the timed operation, so their bytes are
+  the ones of --alloc-stats.
+*/
+
+namespace {
+struct Options {
+  bool json{false};
+  std::string filter{};
+  uint64_t min_time_ms{200};
+  uint64_t repetitions{5};
+};
+
+struct Measure {
+  uint64_t iterations{0};
+  uint64_t nanoseconds{0};
+  uint64_t allocations{0};
+  uint64_t peak_bytes{0};
+};
+
+// Prepare the state of one iteration (untimed) and return the timed
+// operation
+using Benchmark = std::function<std::function<void()>()>;
+
+auto RunOnce(const Benchmark &benchmark, uint64_t iterations) -> Measure {
+  Measure measure;
+  measure.iterations = iterations;
+
+  for (uint64_t i = 0; i < iterations; ++i) {
+    auto operation = benchmark();
+
+    static_cast<void>(AllocationProfiler::Take());
+    const auto start = std::chrono::steady_clock::now();
+    {
+      // the peak is recorded when the scope ends
+      const AllocationScope scope{AllocationProfiler::Phase::kOther};
+      operation();
+    }
+    const auto end = std::chrono::steady_clock::now();
+    const auto counters = AllocationProfiler::Take();
+
+    measure.nanoseconds += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+            .count());
+    for (const auto &phase_counters : counters) {
+      measure.allocations += phase_counters.allocations;
+    }
+    measure.peak_bytes =
+        std::max(measure.peak_bytes,
+                 counters[static_cast<std::size_t>(
+                              AllocationProfiler::Phase::kOther)]
+                     .peak_bytes);
+  }
+  return measure;
+}
+
+auto Run(const Benchmark &benchmark, const Options &options) -> Measure {
+  const uint64_t min_time = options.min_time_ms * 1000000;
+
+  // Calibrate the number of iterations
+  uint64_t iterations{1};
+  auto measure = RunOnce(benchmark, iterations);
+  while (measure.nanoseconds < min_time && iterations < (1U << 30U)) {
+    iterations = measure.nanoseconds == 0
+                     ? iterations * 10
+                     : std::max(iterations + 1,
+                                iterations * min_time / measure.nanoseconds);
+    measure = RunOnce(benchmark, iterations);
+  }
+
+  for (uint64_t i = 1; i < options.repetitions; ++i) {
+    const auto repetition = RunOnce(benchmark, iterations);
+    if (repetition.nanoseconds < measure.nanoseconds) {
+      measure = repetition;
+    }
+  }
+  return measure;
+}
+
+// ((p^q)v(p^q)) nested depth times: 2^depth literals
+auto WideFormula(uint64_t depth) -> std::string {
+  std::string formula = "(p^q)";
+  for (uint64_t i = 0; i < depth; ++i) {
+    formula = "(" + formula + "v" + formula + ")";
+  }
+  return formula;
+}
+
+// (p^(p^(...^p))) with depth binary connectives
+auto DeepFormula(uint64_t depth) -> std::string {
+  std::string formula;
+  for (uint64_t i = 0; i < depth; ++i) {
+    formula += "(p^";
+  }
+  formula += "p";
+  formula.append(depth, ')');
+  return formula;
+}
+
+// Ax followed by a wide body over x
+auto QuantifiedFormula(uint64_t depth) -> std::string {
+  std::string formula = "(P(x,y)^Q(y,x))";
+  for (uint64_t i = 0; i < depth; ++i) {
+    formula = "(" + formula + "v" + formula + ")";
+  }
+  return "Ax" + formula;
+}
+
+// A theory with many literals and queued formulas, and one beta formula
+// to expand
+auto LargeTheory() -> Theory {
+  const std::vector<std::string> predicates{"P", "Q", "R", "S"};
+  const std::vector<std::string> variables{"x", "y", "z", "w"};
+
+  Theory theory;
+  for (const auto &predicate : predicates) {
+    for (const auto &left : variables) {
+      for (const auto &right : variables) {
+        const auto atom = predicate + "(" + left + "," + right + ")";
+        theory.Append(TableauFormula{Parser::Parse(atom).GetFormula()});
+      }
+    }
+  }
+  theory.Append(TableauFormula{Parser::Parse("(pvq)").GetFormula()});
+  return theory;
+}
+
+// Pigeonhole principle: 3 pigeons in 2 holes (unsatisfiable)
+constexpr std::string_view kPigeonhole{
+    "((((pvq)^(rvs))^(((p^r)>-p)^((q^s)>-q)))^(-(p^r)^-(q^s)))"};
+
+auto Benchmarks() -> std::vector<std::pair<std::string, Benchmark>> {
+  std::vector<std::pair<std::string, Benchmark>> benchmarks;
+
+  const auto wide = WideFormula(12);
+  const auto deep = DeepFormula(20000);
+  const auto quantified = QuantifiedFormula(10);
+
+  benchmarks.emplace_back("parse/wide", [wide] {
+    return [&wide] { (void)Parser::Parse(wide); };
+  });
+  benchmarks.emplace_back("parse/deep", [deep] {
+    return [&deep] { (void)Parser::Parse(deep); };
+  });
+
+  const auto wide_out = Parser::Parse(wide);
+  benchmarks.emplace_back("description/wide", [wide_out] {
+    return [&wide_out] { (void)wide_out.GetFormula().Description(); };
+  });
+
+  benchmarks.emplace_back("destroy/deep", [deep] {
+    auto formula = std::make_shared<std::optional<Formula>>(
+        Parser::Parse(deep).GetFormula());
+    return [formula] { formula->reset(); };
+  });
+
+  const TableauFormula quantified_formula{
+      Parser::Parse(quantified).GetFormula()};
+  benchmarks.emplace_back("instantiate/wide", [quantified_formula] {
+    return [&quantified_formula] {
+      TableauStats stats;
+      (void)quantified_formula.Instantiate(Token{"c"}, stats);
+    };
+  });
+
+  const auto theory = LargeTheory();
+  benchmarks.emplace_back("try_expand/copy", [theory] {
+    auto copy = std::make_shared<Theory>(theory);
+    return [copy] {
+      TableauStats stats;
+      std::vector<Theory> theories;
+      copy->TryExpand(TableauOptions{}, stats, theories);
+    };
+  });
+
+  const auto pigeonhole = Parser::Parse(std::string{kPigeonhole});
+  benchmarks.emplace_back("solve/pigeonhole", [pigeonhole] {
+    return [&pigeonhole] { (void)Tableau::Solve(pigeonhole); };
+  });
+
+  const auto predicate = Parser::Parse("(ExP(x,x)^AyEx-P(x,y))");
+  benchmarks.emplace_back("solve/predicate", [predicate] {
+    return [&predicate] { (void)Tableau::Solve(predicate); };
+  });
+
+  return benchmarks;
+}
+
+auto ParseArguments(int argc, char *argv[], Options &options) -> bool {
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg{argv[i]};
+    if (arg == "--json") {
+      options.json = true;
+    } else if (arg.substr(0, 9) == "--filter=") {
+      options.filter = arg.substr(9);
+    } else if (arg.substr(0, 14) == "--min-time-ms=") {
+      options.min_time_ms = std::strtoull(argv[i] + 14, nullptr, 10);
+    } else if (arg.substr(0, 14) == "--repetitions=") {
+      options.repetitions =
+          std::max<uint64_t>(1, std::strtoull(argv[i] + 14, nullptr, 10));
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+} // namespace
+
+auto main(int argc, char *argv[]) -> int {
+  Options options;
+  if (!ParseArguments(argc, argv, options)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--json] [--filter=SUBSTRING] [--min-time-ms=N]"
+                 " [--repetitions=N]\n";
+    return 1;
+  }
+  AllocationProfiler::SetEnabled(true);
+
+  if (!options.json) {
+    std::cout << std::left << std::setw(20) << "benchmark" << std::right
+              << std::setw(12) << "ns/op" << std::setw(12) << "allocs/op"
+              << std::setw(12) << "peak bytes" << "\n";
+  }
+
+  bool matched{false};
+  for (const auto &[name, benchmark] : Benchmarks()) {
+    if (name.find(options.filter) == std::string::npos) {
+      continue;
+    }
+
+    const auto measure = Run(benchmark, options);
+    const auto ns_per_op = measure.nanoseconds / measure.iterations;
+    const auto allocs_per_op = measure.allocations / measure.iterations;
+
+    if (options.json) {
+      // One JSON object per line
+      std::cout << "{\"name\":\"" << name
+                << "\",\"iterations\":" << measure.iterations
+                << ",\"ns_per_op\":" << ns_per_op
+                << ",\"allocs_per_op\":" << allocs_per_op
+                << ",\"peak_bytes\":" << measure.peak_bytes << "}\n";
+    } else {
+      std::cout << std::left << std::setw(20) << name << std::right
+                << std::setw(12) << ns_per_op << std::setw(12)
+                << allocs_per_op << std::setw(12) << measure.peak_bytes
+                << "\n";
+    }
+    matched = true;
+  }
+
+  // Peak resident memory of the whole process (setups included)
+  struct rusage usage {};
+  if (::getrusage(RUSAGE_SELF, &usage) == 0) {
+    if (options.json) {
+      std::cout << "{\"name\":\"process\",\"max_rss_kib\":"
+                << usage.ru_maxrss << "}\n";
+    } else {
+      std::cout << "max resident memory: " << usage.ru_maxrss << " KiB\n";
+    }
+  }
+
+  return matched ? 0 : 1;
+}
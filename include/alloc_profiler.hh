@@ -0,0 +1,99 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+/*
+  Count the allocations of the program, attributed to the phase that makes
+  them (parsing, rendering, rule applications, ...)
+
+  The counters are only updated through ProfiledAllocate/ProfiledFree, so an
+  executable has to replace the global operator new/delete with them (see
+  profiled_new.cc, linked into main.out and bench.out). This keeps the
+  library free of such a replacement.
+
+  Nothing is counted until AllocationProfiler::SetEnabled(true), which must
+  be called before the threads are started. Counters are per thread, so a
+  piece of work done on one thread (e.g. a line of the input file) is
+  measured by calling Take before and after it.
+*/
+class AllocationProfiler {
+public:
+  // kOther is everything outside an AllocationScope
+  enum class Phase : uint8_t {
+    kOther,
+    kParse,
+    kDescribe,
+    kExpand,
+    kSubstitute,
+    kTheoryCopy,
+    kDestroy,
+  };
+  static constexpr std::size_t kPhases{7};
+
+  struct Counters {
+    uint64_t allocations{0};
+    // usable size of the blocks, which malloc may round up
+    uint64_t bytes{0};
+    uint64_t frees{0};
+    // The most bytes held at once by a single scope of the phase, above what
+    // was held when it started (allocations of nested scopes included)
+    uint64_t peak_bytes{0};
+
+    auto operator+=(const Counters &other) -> Counters &;
+  };
+
+  using PhaseCounters = std::array<Counters, kPhases>;
+
+  [[nodiscard]] static auto Enabled() -> bool { return enabled_; }
+  static auto SetEnabled(bool enabled) -> void { enabled_ = enabled; }
+
+  // The counters of this thread since the last call, which are reset
+  // (peak_bytes only covers the scopes that ended in between)
+  static auto Take() -> PhaseCounters;
+
+  [[nodiscard]] static auto PhaseName(Phase phase) -> const char *;
+
+private:
+  inline static bool enabled_{false};
+};
+
+// Attribute the allocations made during the lifetime of the scope to phase
+class AllocationScope {
+public:
+  explicit AllocationScope(AllocationProfiler::Phase phase) {
+    if (AllocationProfiler::Enabled()) {
+      Begin(phase);
+    }
+  }
+
+  ~AllocationScope() {
+    if (active_) {
+      End();
+    }
+  }
+
+  AllocationScope(const AllocationScope &) = delete;
+  AllocationScope(AllocationScope &&) = delete;
+  auto operator=(const AllocationScope &) -> AllocationScope & = delete;
+  auto operator=(AllocationScope &&) -> AllocationScope & = delete;
+
+private:
+  auto Begin(AllocationProfiler::Phase phase) -> void;
+  auto End() -> void;
+
+  bool active_{false};
+  AllocationProfiler::Phase previous_phase_{};
+  int64_t start_live_{0};
+  int64_t previous_peak_{0};
+};
+
+// Allocate/free through malloc, counting the block if the profiler is
+// enabled
+// To be called by the replacements of the global operator new/delete
+[[nodiscard]] auto ProfiledAllocate(std::size_t size) -> void *;
+// Through posix_memalign, for the operator new of over-aligned types
+[[nodiscard]] auto ProfiledAllocate(std::size_t size, std::size_t alignment)
+    -> void *;
+auto ProfiledFree(void *pointer) -> void;
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "writer.hh"
+
+/*
+  Run independent tasks on worker threads, and write their outputs in the
+  order of submission (reorder buffer)
+
+  The outputs are written by the thread that submits the tasks, so that the
+  output is the same as running the tasks one after another. At most
+  kWindowPerJob tasks per worker are pending or waiting to be written:
+  Submit blocks on the oldest one beyond that, which bounds the memory used
+  by huge inputs.
+*/
+class BatchRunner {
+public:
+  // What the task writes to the standard output and error
+  struct Output {
+    std::string out;
+    std::string err;
+  };
+
+  using Task = std::function<Output()>;
+
+  // jobs == 0 => one worker per hardware thread
+  explicit BatchRunner(uint64_t jobs, Writer &out, Writer &err);
+
+  // Finish the tasks that are still pending
+  ~BatchRunner();
+  BatchRunner(const BatchRunner &) = delete;
+  BatchRunner(BatchRunner &&) = delete;
+  auto operator=(const BatchRunner &) -> BatchRunner & = delete;
+  auto operator=(BatchRunner &&) -> BatchRunner & = delete;
+
+  auto Submit(Task task) -> void;
+
+  // Wait for the tasks submitted so far and write their outputs
+  auto Drain() -> void;
+
+  // Drain and stop the workers
+  auto Finish() -> void;
+
+private:
+  static constexpr uint64_t kWindowPerJob{64};
+
+  auto Work() -> void;
+
+  // Write the outputs that are ready in order
+  // If wait, block until fewer than window_ outputs are left
+  auto Emit(std::unique_lock<std::mutex> &lock, bool wait) -> void;
+
+  Writer &out_;
+  Writer &err_;
+  uint64_t window_{0};
+
+  std::mutex mutex_{};
+  std::condition_variable work_cv_{};
+  std::condition_variable done_cv_{};
+  // tasks not started yet, with their index
+  std::deque<std::pair<uint64_t, Task>> tasks_{};
+  // outputs of the tasks not written yet, the first one has index written_
+  std::deque<std::optional<Output>> outputs_{};
+  uint64_t written_{0};
+  bool stopping_{false};
+
+  std::vector<std::thread> workers_{};
+};
@@ -16,11 +16,24 @@ public:
     return generated_constants_[num];
   }
 
+  // Constants added so far, in the order of their num
+  [[nodiscard]] auto Consts() const -> const std::vector<Token> & {
+    return generated_constants_;
+  }
+
+  // Number of constants added so far
+  [[nodiscard]] auto Size() const -> uint64_t {
+    return generated_constants_.size();
+  }
+
   // If we can add more const
   [[nodiscard]] auto CanAddConst() const -> bool {
     return generated_constants_.size() < kLimit;
   }
 
+  // Maximum number of constants of a theory
+  [[nodiscard]] static constexpr auto Limit() -> uint64_t { return kLimit; }
+
   // Add a new constant and Return it
   auto AddConst() -> Token {
     return generated_constants_.emplace_back(
@@ -7,7 +7,9 @@ struct BinaryExpr final : public Expr {
   explicit BinaryExpr(ExprKind type, std::shared_ptr<Expr> expr_lhs,
                       std::shared_ptr<Expr> expr_rhs)
       : Expr(type), expr_lhs_(std::move(expr_lhs)),
-        expr_rhs_(std::move(expr_rhs)) {}
+        expr_rhs_(std::move(expr_rhs)) {
+    Summarize();
+  }
 
   auto Append(std::shared_ptr<Expr> expr) -> void final;
   auto Append(ExprKind type) -> void final;
@@ -21,4 +23,19 @@ struct BinaryExpr final : public Expr {
   }
 
   std::shared_ptr<Expr> expr_lhs_{}, expr_rhs_{};
+
+private:
+  // Set what the expr derives from its children, once they are known
+  auto Summarize() -> void {
+    SetHash(HashCombine(
+        HashCombine(static_cast<std::size_t>(Type()), expr_lhs_->Hash()),
+        expr_rhs_->Hash()));
+    const bool associative =
+        Type() == ExprKind::kAnd || Type() == ExprKind::kOr;
+    SetChain(expr_lhs_->HasChain() || expr_rhs_->HasChain() ||
+             (associative && (expr_lhs_->Type() == Type() ||
+                              expr_rhs_->Type() == Type())));
+    SetTreeBytes(sizeof(BinaryExpr),
+                 expr_lhs_->TreeBytes() + expr_rhs_->TreeBytes());
+  }
 };
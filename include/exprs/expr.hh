@@ -1,5 +1,8 @@
 #pragma once
 
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -37,9 +40,41 @@ public:
 
   virtual auto Accept(ExprVisitor &visitor) const -> void = 0;
 
+  // Structural hash, set as soon as the expr is complete, so that it is
+  // never written once the expr is shared (e.g. between threads)
+  [[nodiscard]] auto Hash() const -> std::size_t { return hash_; }
+
+  // Whether a ^ or v of the expr has an operand with the same connective,
+  // i.e. whether Formula::FlattenConnectives has anything to do
+  [[nodiscard]] auto HasChain() const -> bool { return chain_; }
+
+  // Bytes of the tree of the expr if none of its subtrees were shared (as
+  // Formula::Deserialize rebuilds it), set along with the hash
+  [[nodiscard]] auto TreeBytes() const -> uint64_t { return tree_bytes_; }
+
+protected:
+  // make_shared control block and malloc header of every node, roughly
+  static constexpr uint64_t kNodeOverhead{4 * sizeof(void *)};
+
+  auto SetHash(std::size_t hash) -> void { hash_ = hash; }
+  auto SetChain(bool chain) -> void { chain_ = chain; }
+  // node is the size of the expr itself, children the TreeBytes of its
+  // children
+  auto SetTreeBytes(uint64_t node, uint64_t children) -> void {
+    tree_bytes_ = static_cast<uint32_t>(
+        std::min<uint64_t>(node + kNodeOverhead + children, UINT32_MAX));
+  }
+
+  [[nodiscard]] static auto HashCombine(std::size_t seed, std::size_t value)
+      -> std::size_t {
+    return seed ^ (value + 0x9e3779b97f4a7c15ULL + (seed << 6U) + (seed >> 2U));
+  }
+
 private:
   ExprKind type_{ExprKind::kNull};
   bool error_{false};
-
-  friend class Formula;
+  bool chain_{false};
+  // saturated, and packed with the flags so that it takes no room
+  uint32_t tree_bytes_{0};
+  std::size_t hash_{0};
 };
@@ -44,6 +44,10 @@ public:
            type == ExprKind::kOr;
   }
 
+  [[nodiscard]] static auto IsBeta(ExprKind type) -> bool {
+    return type == ExprKind::kOr || type == ExprKind::kImpl;
+  }
+
   [[nodiscard]] static auto Negate(ExprKind type) -> ExprKind {
     switch (type) {
     case ExprKind::kAnd:
@@ -1,10 +1,20 @@
 #pragma once
 
 #include "exprs/expr.hh"
+#include "literal_table.hh"
 
 struct Literal : public Expr {
   explicit Literal(Token val)
-      : Expr(ExprKind::kLiteral), val_{std::move(val)} {}
+      : Expr(ExprKind::kLiteral), val_{std::move(val)},
+        key_{LiteralTable::Intern(val_.View())} {
+    SetHash(HashCombine(static_cast<std::size_t>(Type()), key_));
+    SetTreeBytes(sizeof(Literal), 0);
+  }
+  ~Literal() override { LiteralTable::Release(); }
+  Literal(const Literal &) = delete;
+  Literal(Literal &&) = delete;
+  auto operator=(const Literal &) -> Literal & = delete;
+  auto operator=(Literal &&) -> Literal & = delete;
 
   auto Append(std::shared_ptr<Expr> expr) -> void final {
     (void)expr;
@@ -23,12 +33,25 @@ struct Literal : public Expr {
   }
 
   Token val_;
+  // the literal as a whole, e.g. P(a,b) for a PredicateLiteral
+  LiteralTable::Key key_;
+
+protected:
+  explicit Literal(Token &&val, LiteralTable::Key key)
+      : Expr(ExprKind::kLiteral), val_{std::move(val)}, key_{key} {
+    SetHash(HashCombine(static_cast<std::size_t>(Type()), key_));
+    SetTreeBytes(sizeof(Literal), 0);
+  }
 };
 
 struct PredicateLiteral final : public Literal {
   explicit PredicateLiteral(Token val, Token left, Token right)
-      : Literal(std::move(val)), left_var_(std::move(left)),
-        right_var_(std::move(right)) {}
+      // val is only moved from by Literal, after the key is computed
+      : Literal(std::move(val),
+                LiteralTable::Intern(val.View(), left.View(), right.View())),
+        left_var_(std::move(left)), right_var_(std::move(right)) {
+    SetTreeBytes(sizeof(PredicateLiteral), 0);
+  }
 
   auto Accept(ExprVisitor &visitor) const -> void final {
     visitor.Visit(*this);
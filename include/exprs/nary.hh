@@ -0,0 +1,45 @@
+#pragma once
+
+#include <vector>
+
+#include "exprs/expr.hh"
+
+// A chain of the same associative connective (^ or v) with more than two
+// operands, e.g. ((p^q)^r) as (p^q^r)
+// It is never built by the parser (see Formula::FlattenConnectives)
+struct NaryExpr final : public Expr {
+  explicit NaryExpr(ExprKind type, std::vector<std::shared_ptr<Expr>> exprs)
+      : Expr(type), exprs_(std::move(exprs)) {
+    auto hash = static_cast<std::size_t>(Type());
+    bool chain{false};
+    uint64_t children{exprs_.capacity() * sizeof(std::shared_ptr<Expr>)};
+    for (const auto &expr : exprs_) {
+      hash = HashCombine(hash, expr->Hash());
+      chain = chain || expr->HasChain() || expr->Type() == Type();
+      children += expr->TreeBytes();
+    }
+    SetHash(hash);
+    SetChain(chain);
+    SetTreeBytes(sizeof(NaryExpr), children);
+  }
+
+  auto Append(std::shared_ptr<Expr> expr) -> void final {
+    (void)expr;
+    SetError();
+  }
+
+  auto Append(ExprKind type) -> void final {
+    (void)type;
+    SetError();
+  }
+
+  [[nodiscard]] auto Complete() const -> bool final {
+    return exprs_.size() >= 2;
+  }
+
+  auto Accept(ExprVisitor &visitor) const -> void final {
+    visitor.Visit(*this);
+  }
+
+  std::vector<std::shared_ptr<Expr>> exprs_;
+};
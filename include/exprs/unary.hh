@@ -5,7 +5,9 @@
 struct UnaryExpr : public Expr {
   explicit UnaryExpr(ExprKind type) : Expr(type) {}
   explicit UnaryExpr(ExprKind type, std::shared_ptr<Expr> expr)
-      : Expr(type), expr_(std::move(expr)) {}
+      : Expr(type), expr_(std::move(expr)) {
+    Summarize();
+  }
 
   auto Append(std::shared_ptr<Expr> expr) -> void final {
     if (expr_) {
@@ -14,6 +16,7 @@ struct UnaryExpr : public Expr {
     }
 
     expr_ = std::move(expr);
+    Summarize();
   }
 
   auto Append(ExprKind type) -> void final {
@@ -30,6 +33,25 @@ struct UnaryExpr : public Expr {
   }
 
   std::shared_ptr<Expr> expr_{};
+
+protected:
+  // Add the infos of the expr to its hash, and the size of the expr itself
+  // (see QuantifiedUnaryExpr)
+  [[nodiscard]] virtual auto HashInfos(std::size_t hash) const
+      -> std::size_t {
+    return hash;
+  }
+  [[nodiscard]] virtual auto NodeBytes() const -> uint64_t {
+    return sizeof(UnaryExpr);
+  }
+
+  // Set what the expr derives from its child, once it is known
+  auto Summarize() -> void {
+    SetHash(HashCombine(HashInfos(static_cast<std::size_t>(Type())),
+                        expr_->Hash()));
+    SetChain(expr_->HasChain());
+    SetTreeBytes(NodeBytes(), expr_->TreeBytes());
+  }
 };
 
 // A Special UnaryExpr Expr where E is a quantifier
@@ -40,11 +62,23 @@ public:
       : UnaryExpr(type), var_(std::move(var)) {}
   explicit QuantifiedUnaryExpr(ExprKind type, Token var,
                                std::shared_ptr<Expr> expr)
-      : UnaryExpr(type, std::move(expr)), var_(std::move(var)) {}
+      : UnaryExpr(type, std::move(expr)), var_(std::move(var)) {
+    // UnaryExpr summarized it as a plain UnaryExpr, before var_ was set
+    Summarize();
+  }
 
   auto Accept(ExprVisitor &visitor) const -> void final {
     visitor.Visit(*this);
   }
 
   Token var_;
+
+private:
+  [[nodiscard]] auto HashInfos(std::size_t hash) const
+      -> std::size_t final {
+    return HashCombine(hash, std::hash<Token>()(var_));
+  }
+  [[nodiscard]] auto NodeBytes() const -> uint64_t final {
+    return sizeof(QuantifiedUnaryExpr);
+  }
 };
@@ -2,11 +2,14 @@
 
 #include <cstddef>
 #include <memory>
+#include <string>
+#include <string_view>
 #include <vector>
 
 #include "exprs/expr.hh"
 #include "exprs/kind.hh"
 #include "formula.hh"
+#include "literal_table.hh"
 
 /*
   Manage the lifetime of the Expr
@@ -26,10 +29,64 @@ public:
 
   [[nodiscard]] auto Description() const -> std::string;
 
-  [[nodiscard]] auto Connective() const -> std::string;
+  // Same as Description, appended to out (no temporary string)
+  auto AppendDescription(std::string &out) const -> void;
+
+  [[nodiscard]] auto Connective() const -> std::string_view;
 
   [[nodiscard]] auto ViewChildren() const -> std::vector<Formula>;
 
+  // Tokens of the root expr, e.g. the predicate and its variables
+  // (see InfoVisitor)
+  [[nodiscard]] auto ViewInfos() const -> std::vector<Token>;
+
+  // Same formula where every chain of ^ (or of v), e.g. ((p^q)^r), is one
+  // NaryExpr (p^q^r), so that a rule expands it in one step
+  // The subtrees without such chains are shared with this formula
+  [[nodiscard]] auto FlattenConnectives() const -> Formula;
+
+  struct LiteralView {
+    // whether the formula is a literal under zero or more negations
+    bool literal{false};
+    LiteralTable::Key key{0};
+    uint64_t negations{0};
+  };
+
+  // The literal under the negations of the formula, e.g. P(a,b) and 2
+  // for --P(a,b) (no allocation, unlike ViewChildren)
+  // Not a literal beyond max_negations, without walking the rest of the
+  // negations
+  [[nodiscard]] auto ViewLiteral(uint64_t max_negations) const
+      -> LiteralView;
+
+  // Hash of the structure of the formula (types and tokens)
+  // Computed by the exprs as they are built (see Expr::Hash)
+  [[nodiscard]] auto Hash() const -> std::size_t { return expr_->Hash(); }
+
+  // Bytes of the exprs of the formula, as if it shared none of them
+  // (see Expr::TreeBytes)
+  [[nodiscard]] auto TreeBytes() const -> uint64_t {
+    return expr_->TreeBytes();
+  }
+
+  // Append the exprs of the formula to out in post-order
+  // Subtrees shared inside the formula are written once per occurrence
+  auto Serialize(std::string &out) const -> void;
+
+  // Rebuild a formula written by Serialize and consume it from in
+  [[nodiscard]] static auto Deserialize(std::string_view &in) -> Formula;
+
 protected:
   std::shared_ptr<Expr> expr_{};
+
+  // Structural equality
+  friend auto operator==(const Formula &lhs, const Formula &rhs) -> bool;
+};
+
+namespace std {
+template <> struct hash<Formula> {
+  auto operator()(const Formula &formula) const -> size_t {
+    return formula.Hash();
+  }
 };
+} // namespace std
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+
+#include "formula.hh"
+#include "tableau.hh"
+
+/*
+  Free-variable tableau for first order formulas
+
+  Instead of guessing the constants that instantiate a universal formula,
+  gamma expansion introduces a fresh free variable, and delta expansion
+  introduces a Skolem term over the free variables of the existential
+  formula (the same symbol for the same formula, as in the delta++ rule).
+  The tableau is closed if a single substitution unifies a pair of
+  complementary literals on every branch.
+
+  Universal formulas are instantiated at most depth times per branch, and
+  depth is increased from 1 up to max_depth (iterative deepening).
+
+  A closed tableau proves that the formula has no model with a non-empty
+  domain. The ground tableau also allows an empty domain (a universal
+  formula holds when there are no constants), so the formula is only
+  unsatisfiable if it is false in the empty domain as well, and Refute
+  checks that first. Otherwise, nothing can be concluded and the ground
+  tableau has to decide.
+*/
+class FreeVariableTableau {
+public:
+  // true => formula is unsatisfiable
+  [[nodiscard]] static auto Refute(const Formula &formula, uint64_t max_depth,
+                                   const TableauOptions &options,
+                                   TableauStats &stats) -> bool;
+};
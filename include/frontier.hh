@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+
+#include "tableau.hh"
+
+/*
+  FIFO of the theories waiting to be expanded (LIFO in depth-first mode)
+
+  Popped theories are released right away. Once the theories kept in memory
+  exceed the memory budget, the following ones are serialized to a temporary
+  spill file and read back (in order) when the in-memory part runs out.
+  A depth-first frontier only grows with the depth of the tableau, so it is
+  never spilled.
+*/
+class Frontier {
+public:
+  // memory_budget == 0 => never spill
+  explicit Frontier(uint64_t memory_budget, bool depth_first = false)
+      : memory_budget_{memory_budget}, depth_first_{depth_first} {}
+
+  ~Frontier();
+  Frontier(const Frontier &) = delete;
+  Frontier(Frontier &&) = delete;
+  auto operator=(const Frontier &) -> Frontier & = delete;
+  auto operator=(Frontier &&) -> Frontier & = delete;
+
+  auto Push(Theory theory) -> void;
+
+  // Frontier must not be empty
+  [[nodiscard]] auto Pop() -> Theory;
+
+  [[nodiscard]] auto Empty() const -> bool {
+    return memory_.empty() && spilled_ == 0;
+  }
+
+  [[nodiscard]] auto Size() const -> uint64_t {
+    return memory_.size() + spilled_;
+  }
+
+private:
+  // Write the theory to the end of the spill file
+  // Return false if it could not be written
+  auto Spill(const Theory &theory) -> bool;
+
+  // Read back spilled theories until the memory budget is reached
+  auto Refill() -> void;
+
+  std::deque<Theory> memory_{};
+  uint64_t memory_bytes_{0};
+  uint64_t memory_budget_;
+  bool depth_first_;
+
+  std::FILE *spill_file_{nullptr};
+  uint64_t spilled_{0};
+  long read_offset_{0};
+  long write_offset_{0};
+};
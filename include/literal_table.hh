@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <string_view>
+
+/*
+  Intern the literals of the formulas (e.g. p or P(a,b)) into small integers,
+  so that a branch compares its literals without rendering them
+
+  Every Literal is given its key when it is built, and releases it when it is
+  destroyed. The table is shared by all the threads and is emptied once no
+  Literal is left (e.g. between two requests of a server), so that it only
+  holds the literals of the formulas being solved rather than all the ones
+  ever seen. A key stays meaningful while any Literal is alive, which lets
+  a solve keep keys without their Literal (e.g. Theory::Serialize) since its
+  input formula holds Literals until the end.
+*/
+class LiteralTable {
+public:
+  using Key = uint32_t;
+
+  [[nodiscard]] static auto Intern(std::string_view proposition) -> Key;
+
+  // Key of predicate(left,right)
+  [[nodiscard]] static auto Intern(std::string_view predicate,
+                                   std::string_view left,
+                                   std::string_view right) -> Key;
+
+  // Called once per key given by Intern, when its Literal is destroyed
+  static auto Release() -> void;
+};
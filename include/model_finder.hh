@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstdint>
+
+#include "formula.hh"
+#include "tableau.hh"
+
+/*
+  Finite model finding for first order formulas
+
+  For every domain size n from 1 up to max_size, the formula is grounded
+  over the elements {0, ..., n - 1}: a universal formula becomes the
+  conjunction of its n instances, an existential formula the disjunction.
+  Every instance of a predicate (e.g. P(0,1)) is a propositional variable,
+  and the ground formula is decided by a DPLL procedure.
+
+  Without equality, a model of size n can be extended to any larger size,
+  so the sizes are tried in increasing order and the first model found is
+  the smallest one.
+
+  Formulas with free variables are not handled, since the ground tableau
+  reads them as constants that are not part of the domain.
+*/
+class ModelFinder {
+public:
+  // Size of the model found, 0 => no model up to max_size (or over budget)
+  [[nodiscard]] static auto FindModel(const Formula &formula,
+                                      uint64_t max_size, TableauStats &stats)
+      -> uint64_t;
+};
@@ -2,12 +2,45 @@
 
 #include <memory>
 #include <optional>
+#include <stack>
+#include <string>
+#include <string_view>
 #include <utility>
 
 #include "exprs/expr.hh"
 #include "formula.hh"
 #include "tokenizer.hh"
 
+// The exprs that are being built by the parser
+class ExprStack : std::stack<std::shared_ptr<Expr>> {
+public:
+  using std::stack<std::shared_ptr<Expr>>::empty;
+  using std::stack<std::shared_ptr<Expr>>::top;
+  using std::stack<std::shared_ptr<Expr>>::pop;
+  using std::stack<std::shared_ptr<Expr>>::emplace;
+
+  ExprStack() = default;
+  ~ExprStack() {
+    while (!empty()) {
+      [[maybe_unused]] Formula expr_destructor{std::move(top())};
+      pop();
+    }
+  }
+  ExprStack(const ExprStack &) = delete;
+  ExprStack(ExprStack &&) = delete;
+  auto operator=(const ExprStack &) -> ExprStack & = delete;
+  auto operator=(ExprStack &&) -> ExprStack & = delete;
+
+  [[nodiscard]] auto Error() const -> bool { return error_; }
+  auto SetError() -> void { error_ = true; }
+
+  auto Holder() -> std::shared_ptr<Expr> & { return holder_; }
+
+private:
+  std::shared_ptr<Expr> holder_{};
+  bool error_{false};
+};
+
 class Parser {
 public:
   enum class ParseResult { kNotAFormula, kProposition, kPredicate };
@@ -37,5 +70,38 @@ public:
     enum ParseResult result_;
   };
 
+  /*
+    Parse one formula fed in chunks of any size (e.g. blocks read from a
+    file), which do not need to end between tokens
+
+    Only the exprs being built (and the first tokens of a quantifier or of
+    a predicate) are kept between the chunks, so the text of the formula is
+    not held in memory unless keep_raw (then RawFormula() is the text fed,
+    otherwise it is empty).
+  */
+  class Stream {
+  public:
+    explicit Stream(bool keep_raw = false) : keep_raw_{keep_raw} {}
+
+    auto Feed(std::string_view chunk) -> void;
+
+    // End of the formula (a stream parses a single formula)
+    [[nodiscard]] auto Finish() -> ParserOutput;
+
+  private:
+    auto Consume(char c) -> void;
+    [[nodiscard]] auto Finish(std::string raw_formula) -> ParserOutput;
+
+    ExprStack stack_{};
+    // a quantifier or a predicate followed by the tokens read so far
+    std::string pending_{};
+    bool proposition_{false};
+    bool predicate_{false};
+    bool keep_raw_;
+    std::string raw_formula_{};
+
+    friend class Parser;
+  };
+
   [[nodiscard]] static auto Parse(std::string line) -> ParserOutput;
 };
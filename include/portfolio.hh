@@ -0,0 +1,25 @@
+#pragma once
+
+#include "parser.hh"
+#include "tableau.hh"
+
+/*
+  Solve a formula with several strategies at once
+
+  No configuration of the tableau is the fastest on every formula, so the
+  strategies derived from the options (as given, depth-first, semantic
+  branching with propagation, and for first order formulas batch gamma
+  with constant reuse) run on their own threads. The first definite answer
+  (satisfiable or unsatisfiable) cancels the others, which stop at their
+  next rule application.
+
+  The stats are the ones of the strategy that answered, named in
+  TableauStats::strategy. If none of them decides the formula, the result
+  is the one of the options as given.
+*/
+class Portfolio {
+public:
+  [[nodiscard]] static auto Solve(const Parser::ParserOutput &parser_out,
+                                  const TableauOptions &options)
+      -> Tableau::TableauOutput;
+};
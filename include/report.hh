@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstdint>
+#include <optional>
+
+#include "alloc_profiler.hh"
+#include "formula.hh"
+#include "parser.hh"
+#include "tableau.hh"
+#include "writer.hh"
+
+/*
+  Formatting of the results of parsing and solving a formula, shared by the
+  batch driver (main) and the server
+*/
+
+// Print the description of the formula without a temporary string
+auto operator<<(Writer &out, const Formula &formula) -> Writer &;
+
+// Sentences describing the formula, e.g. "p is a proposition."
+auto PrintParserInformation(Writer &out, const Parser::ParserOutput &parser_out)
+    -> void;
+
+// Sentence of the result, e.g. "p is satisfiable."
+auto PrintTableauInformation(Writer &out,
+                             const Parser::ParserOutput &parser_out,
+                             const Tableau::TableauResult &tableau_out)
+    -> void;
+
+// "satisfiable", "unsatisfiable" or "undecidable"
+[[nodiscard]] auto ResultName(Tableau::TableauResult result) -> const char *;
+
+// Short name of the kind of formula printed by PrintParserInformation
+[[nodiscard]] auto KindName(const Parser::ParserOutput &parser_out)
+    -> const char *;
+
+// One JSON object per line of the input file
+// result and the counters are null if the line is not solved
+auto PrintStatistics(Writer &out, uint64_t line_number,
+                     const std::optional<Tableau::TableauOutput> &tableau_out,
+                     uint64_t nanoseconds) -> void;
+
+// One JSON object with the allocations of every phase, e.g.
+// {"line":2,"parse":{"allocations":...},...}
+// key/value identify what was measured (a line, or all the lines)
+auto PrintAllocationStatistics(
+    Writer &out, const char *key, uint64_t value,
+    const AllocationProfiler::PhaseCounters &counters) -> void;
+
+/*
+  Compact output: one tab-separated record per line of the input file
+    line number, formula, kind (if parse), result (if solved)
+  Fields that are not computed are empty
+*/
+auto PrintRecord(Writer &out, uint64_t line_number,
+                 const Parser::ParserOutput &parser_out, bool parse,
+                 const std::optional<Tableau::TableauOutput> &tableau_out)
+    -> void;
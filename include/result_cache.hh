@@ -0,0 +1,82 @@
+#pragma once
+
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+
+#include "formula.hh"
+#include "tableau.hh"
+
+/*
+  Results of Tableau::Solve kept in a file across runs
+
+  The key is a 128-bit hash of the serialized formula, the options that can
+  change the result and the limit of constants. The file is a header
+  followed by fixed-size records (key, result), in host byte order:
+    - at startup, the file is mapped and indexed in memory
+    - new results are only appended to it (see Flush)
+    - when most records are stale (the same key appended again), the file is
+      rewritten with one record per key and renamed over the old one
+*/
+class ResultCache {
+public:
+  struct Key {
+    uint64_t high;
+    uint64_t low;
+
+    friend auto operator==(const Key &lhs, const Key &rhs) -> bool {
+      return lhs.high == rhs.high && lhs.low == rhs.low;
+    }
+  };
+
+  [[nodiscard]] static auto MakeKey(const Formula &formula,
+                                    const TableauOptions &options) -> Key;
+
+  explicit ResultCache(std::string path) : path_{std::move(path)} {}
+
+  // Flush (and compact)
+  ~ResultCache();
+  ResultCache(const ResultCache &) = delete;
+  ResultCache(ResultCache &&) = delete;
+  auto operator=(const ResultCache &) -> ResultCache & = delete;
+  auto operator=(ResultCache &&) -> ResultCache & = delete;
+
+  // Read the cache file, a missing file is an empty cache
+  // Return false if the file is not a cache file (of this version)
+  auto Load() -> bool;
+
+  // Thread-safe
+  [[nodiscard]] auto Find(const Key &key) const
+      -> std::optional<Tableau::TableauResult>;
+  auto Insert(const Key &key, Tableau::TableauResult result) -> void;
+
+  // Append the new results to the file, or rewrite it if it is mostly stale
+  // Return false if the file could not be written
+  auto Flush() -> bool;
+
+private:
+  struct KeyHash {
+    auto operator()(const Key &key) const -> std::size_t {
+      return static_cast<std::size_t>(key.high ^ key.low);
+    }
+  };
+
+  // Below this many records, the file is never compacted
+  static constexpr uint64_t kMinCompactRecords{1024};
+
+  // Write all the entries to a new file and rename it over path_
+  auto Compact() -> bool;
+
+  std::string path_;
+
+  mutable std::mutex mutex_{};
+  std::unordered_map<Key, Tableau::TableauResult, KeyHash> entries_{};
+  // inserted since the last flush
+  std::unordered_map<Key, Tableau::TableauResult, KeyHash> pending_{};
+  // records in the file (including stale ones)
+  uint64_t records_{0};
+  // the file ends with a partial record (e.g. an interrupted append)
+  bool torn_{false};
+};
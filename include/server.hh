@@ -0,0 +1,83 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "tableau.hh"
+
+/*
+  Answer PARSE/SAT requests in a long-running process
+
+  Requests and responses are lines (framed by '\n') of tab-separated fields
+    request:  id, commands, formula
+      id is an unsigned integer chosen by the client, commands is PARSE,
+      SAT or "PARSE SAT" (as in the header of an input file)
+    response: the record of --format=tsv, with the id as the line number
+      id, formula, kind (if PARSE), result (if SAT)
+  A malformed request is answered with "error", a tab and the request, and
+  a request longer than kMaxRequestSize with "error" alone (the request is
+  dropped up to its '\n').
+
+  The commands PUSH, POP, ASSERT (of the formula) and CHECK drive an
+  IncrementalTableau owned by the connection, and come alone. They are
+  answered with the same fields: the formula for ASSERT, and the result for
+  CHECK. POP without a PUSH is an error.
+
+  Requests may be pipelined: the responses come in the order of the
+  requests. Results of SAT are cached across requests and connections.
+*/
+class Server {
+public:
+  // jobs > 1 => solve the requests of a connection concurrently
+  // (see BatchRunner)
+  explicit Server(const TableauOptions &options, uint64_t jobs)
+      : options_{options}, jobs_{jobs} {}
+
+  // Wait for the connections still served
+  ~Server();
+  Server(const Server &) = delete;
+  Server(Server &&) = delete;
+  auto operator=(const Server &) -> Server & = delete;
+  auto operator=(Server &&) -> Server & = delete;
+
+  // Answer the requests read from in_fd on out_fd, until the end of in_fd
+  // Return false on a read or write error
+  auto Serve(int in_fd, int out_fd) -> bool;
+
+  // Accept connections on a Unix domain socket at path, each one is served
+  // on its own (detached) thread, at most kMaxConnections at a time (the
+  // others wait in the backlog of the socket)
+  // A file at path is only replaced if it is a socket (e.g. left over by a
+  // previous server)
+  // Return false if the socket can not be used
+  auto Listen(const std::string &path) -> bool;
+
+private:
+  static constexpr std::size_t kMaxCachedResults{1U << 20U};
+  static constexpr std::size_t kMaxRequestSize{1U << 20U};
+  // with --jobs=N, every connection also runs N workers (see BatchRunner)
+  static constexpr uint64_t kMaxConnections{32};
+
+  // Response to one request line (with its '\n')
+  [[nodiscard]] auto Answer(const std::string &request) -> std::string;
+
+  TableauOptions options_;
+  uint64_t jobs_;
+
+  // formula as written by the client => result of SAT
+  // Beyond kMaxCachedResults, the oldest entry is evicted (first in, first
+  // out), so that a full cache keeps the recent formulas
+  std::mutex cache_mutex_{};
+  std::unordered_map<std::string, Tableau::TableauResult> cache_{};
+  // keys of cache_ (which its rehashes do not move), oldest first
+  std::deque<const std::string *> cache_order_{};
+
+  // connections being served
+  std::mutex connections_mutex_{};
+  std::condition_variable connections_cv_{};
+  uint64_t connections_{0};
+};
@@ -1,14 +1,101 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <cstddef>
 #include <memory>
-#include <queue>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 #include "constant.hh"
 #include "formula.hh"
+#include "literal_table.hh"
 #include "parser.hh"
+#include "utils/inline_vector.hh"
+
+struct TableauOptions {
+  // Bytes of pending theories kept in memory before the rest are spilled to
+  // a temporary file (0 => no limit)
+  uint64_t memory_budget{0};
+  // Measure the time spent in every rule (counters are always collected)
+  bool collect_stats{false};
+  // Beta rule yields {A}, {-A, B} instead of {A}, {B}, so that the branches
+  // are disjoint
+  bool semantic_branching{false};
+  // Before splitting, look for a beta formula that does not need to split
+  // because the literals of the branch refute or satisfy one of its sides
+  bool propagation{false};
+  // Instantiate a universal formula with all the constants of the branch at
+  // once, rather than with one constant each time it is popped
+  bool batch_gamma{false};
+  // Expand an existential formula without a new constant when the branch
+  // already has an instance of its body for one of its constants, which is
+  // then the witness (liberalized delta rule)
+  bool reuse_constants{false};
+  // Try to refute first order formulas with a free-variable tableau, where
+  // universal formulas are instantiated at most this many times per branch
+  // (0 => disabled, see FreeVariableTableau)
+  uint64_t free_variable_depth{0};
+  // When the ground tableau gives up on a first order formula, look for a
+  // model with at most this many elements (0 => disabled, see ModelFinder)
+  uint64_t model_finding_size{0};
+  // Expand the most recent branch first (LIFO frontier), which keeps fewer
+  // theories pending on formulas with many branches
+  bool depth_first{false};
+  // Run several strategies derived from these options concurrently, and
+  // keep the first definite answer (see Portfolio)
+  bool portfolio{false};
+  // Give up (undecidable) as soon as *cancel is true, checked between rule
+  // applications (nullptr => never cancelled)
+  const std::atomic<bool> *cancel{nullptr};
+
+  [[nodiscard]] auto Cancelled() const -> bool {
+    return cancel != nullptr && cancel->load(std::memory_order_relaxed);
+  }
+};
+
+struct TableauStats {
+  struct RuleStats {
+    uint64_t count{0};
+    uint64_t nanoseconds{0};
+  };
+
+  RuleStats alpha{};
+  RuleStats beta{};
+  RuleStats gamma{};
+  RuleStats delta{};
+  // double negation and the negation of binary/quantified formulas
+  RuleStats negation{};
+
+  uint64_t branches_created{0};
+  uint64_t branches_closed{0};
+  uint64_t theory_copies{0};
+  // exprs built by substituting constants into quantified formulas
+  uint64_t nodes_copied{0};
+  uint64_t constants_introduced{0};
+  // existential formulas expanded with a witness already on the branch
+  // (see TableauOptions::reuse_constants)
+  uint64_t constants_reused{0};
+  uint64_t peak_frontier{0};
+  // beta formulas expanded without a split (see TableauOptions::propagation)
+  uint64_t propagations{0};
+  // clauses of the ground formulas, and the size of the model found (if any)
+  // by ModelFinder
+  uint64_t ground_clauses{0};
+  uint64_t model_size{0};
+  // 1 if the result is read from the cache (see ResultCache), the other
+  // counters are then 0
+  uint64_t cache_hits{0};
+  // Name of the strategy that answered in portfolio mode (nullptr otherwise)
+  const char *strategy{nullptr};
+};
+
+class Expansion;
 
 class TableauFormula final : public Formula {
 public:
@@ -16,36 +103,314 @@ public:
 
   explicit TableauFormula(const Formula &formula);
 
-  [[nodiscard]] auto Expand(ConstantManager &manager)
-      -> std::vector<std::vector<TableauFormula>>;
+  // Write the branches of the rule application into expansion, which is
+  // cleared first (no branch => the formula can not be expanded)
+  auto Expand(ConstantManager &manager, const TableauOptions &options,
+              TableauStats &stats, Expansion &expansion) -> void;
+
+  // Copy the body of a quantified formula with its variable replaced by token
+  [[nodiscard]] auto Instantiate(const Token &token, TableauStats &stats) const
+      -> TableauFormula;
+
+  // Same as Instantiate for every token of [first, last), where the body is
+  // only traversed once
+  [[nodiscard]] auto InstantiateAll(std::vector<Token>::const_iterator first,
+                                    std::vector<Token>::const_iterator last,
+                                    TableauStats &stats) const
+      -> std::vector<TableauFormula>;
+
+  auto Serialize(std::string &out) const -> void;
+  [[nodiscard]] static auto Deserialize(std::string_view &in)
+      -> TableauFormula;
 
 private:
   // next needed constant num
   uint64_t const_num_{0};
 
-  friend auto operator>(const TableauFormula &lhs, const TableauFormula &rhs)
-      -> bool;
+  friend class FormulaQueue;
 };
 
+/*
+  The result of one rule application: the branches it splits a theory into,
+  with the formulas added to each of them
+
+  Binary connectives, quantifiers and negations yield at most two branches
+  of at most two formulas, which are stored inline, so that applying a rule
+  allocates no container for its result. Only wide conjunctions and
+  disjunctions (see Formula::FlattenConnectives) and batch gamma spill to
+  the heap.
+*/
+class Expansion {
+public:
+  static constexpr std::size_t kInlineFormulas{4};
+  static constexpr std::size_t kInlineBranches{2};
+
+  // The formulas of one branch
+  class Branch {
+  public:
+    explicit Branch(const TableauFormula *first, const TableauFormula *last)
+        : first_{first}, last_{last} {}
+
+    [[nodiscard]] auto begin() const -> const TableauFormula * {
+      return first_;
+    }
+    [[nodiscard]] auto end() const -> const TableauFormula * { return last_; }
+
+  private:
+    const TableauFormula *first_;
+    const TableauFormula *last_;
+  };
+
+  [[nodiscard]] auto Empty() const -> bool { return ends_.Empty(); }
+  [[nodiscard]] auto Branches() const -> std::size_t { return ends_.Size(); }
+  [[nodiscard]] auto operator[](std::size_t branch) const -> Branch {
+    return Branch{formulas_.Data() + (branch == 0 ? 0 : ends_[branch - 1]),
+                  formulas_.Data() + ends_[branch]};
+  }
+
+  // Make room for a wide expansion at once
+  auto Reserve(std::size_t branches, std::size_t formulas) -> void {
+    ends_.Reserve(branches);
+    formulas_.Reserve(formulas);
+  }
+
+  // Open a new branch, which the next formulas are added to
+  auto AddBranch() -> void { ends_.Push(formulas_.Size()); }
+  auto Add(TableauFormula formula) -> void {
+    formulas_.Push(std::move(formula));
+    ++ends_[ends_.Size() - 1];
+  }
+
+  auto Clear() -> void {
+    formulas_.Clear();
+    ends_.Clear();
+  }
+
+  // Remove the branches for which predicate(branch) holds, keeping the
+  // order of the others
+  template <typename Predicate>
+  auto RemoveBranchesIf(Predicate predicate) -> void;
+
+private:
+  InlineVector<TableauFormula, kInlineFormulas> formulas_{};
+  // end of every branch in formulas_, the first one starts at 0
+  InlineVector<std::size_t, kInlineBranches> ends_{};
+};
+
+/*
+  The formulas of a theory waiting to be expanded, with one bucket per rule:
+  negations, alpha, delta, beta (v, then >), and then gamma by the number of
+  constants each formula was instantiated with. Pop takes from the first
+  non-empty bucket, so a universal formula is only instantiated again after
+  all the others caught up (see TryExpand). Inside a bucket, the formula
+  pushed last is popped first.
+
+  Every bucket is a persistent stack: a copy of the queue (for a new branch)
+  copies one pointer per bucket, and the branches share the formulas queued
+  before the split. Push and Pop are O(1).
+*/
+class FormulaQueue {
+public:
+  explicit FormulaQueue() = default;
+  ~FormulaQueue();
+  FormulaQueue(const FormulaQueue &) = default;
+  FormulaQueue(FormulaQueue &&other) noexcept;
+  // by value, for both the copy and the move
+  auto operator=(FormulaQueue other) noexcept -> FormulaQueue &;
+
+  [[nodiscard]] auto Empty() const -> bool { return size_ == 0; }
+  [[nodiscard]] auto Size() const -> std::size_t { return size_; }
+  // Sum of the TreeBytes of the formulas
+  [[nodiscard]] auto TreeBytes() const -> uint64_t { return tree_bytes_; }
+
+  // The formula Pop returns
+  [[nodiscard]] auto Top() const -> const TableauFormula &;
+
+  auto Push(TableauFormula formula) -> void;
+  auto Pop() -> TableauFormula;
+
+private:
+  struct Node {
+    TableauFormula formula;
+    std::shared_ptr<Node> next;
+  };
+
+  // kNeg, kAnd, kExist, kOr and kImpl, then kUniversal by const_num_
+  // (a universal formula never gets more constants than the limit)
+  static constexpr std::size_t kRuleBuckets{5};
+  static constexpr std::size_t kBuckets{kRuleBuckets +
+                                        ConstantManager::Limit() + 1};
+
+  [[nodiscard]] static auto BucketOf(const TableauFormula &formula)
+      -> std::size_t;
+  [[nodiscard]] auto TopBucket() const -> std::size_t;
+
+  // Free the nodes only owned by node without recursing along the stack
+  static auto Release(std::shared_ptr<Node> node) -> void;
+
+  std::array<std::shared_ptr<Node>, kBuckets> buckets_{};
+  std::size_t size_{0};
+  uint64_t tree_bytes_{0};
+};
+
+/*
+  The formulas queued on a branch, so that each of them is expanded once
+
+  A hash trie: every node holds up to kNodeFormulas formulas, and once it is
+  full, passes the next ones to one of its children by kBits more bits of
+  their hash. Like FormulaQueue, a copy (for a new branch) shares all the
+  nodes, and Insert only copies the nodes of its path that another set still
+  uses, so a branch pays for the formulas it adds rather than for the ones
+  it inherits.
+*/
+class FormulaSet {
+public:
+  [[nodiscard]] auto Size() const -> std::size_t { return size_; }
+  // Sum of the TreeBytes of the formulas
+  [[nodiscard]] auto TreeBytes() const -> uint64_t { return tree_bytes_; }
+
+  [[nodiscard]] auto Contains(const Formula &formula) const -> bool;
+  // false if the formula was already in the set
+  auto Insert(const Formula &formula) -> bool;
+
+  template <typename Function> auto ForEach(Function function) const -> void;
+
+private:
+  static constexpr std::size_t kNodeFormulas{8};
+  static constexpr unsigned kBits{3};
+  static constexpr std::size_t kChildren{std::size_t{1} << kBits};
+  // the hash has no bits left below this depth, so the last nodes are
+  // never full
+  static constexpr unsigned kMaxDepth{
+      static_cast<unsigned>(8 * sizeof(std::size_t)) / kBits};
+
+  // the hash is kept next to the formula, so that the formulas of a node
+  // are compared without reading their exprs
+  struct Entry {
+    std::size_t hash;
+    Formula formula;
+  };
+
+  struct Node {
+    std::vector<Entry> entries;
+    std::array<std::shared_ptr<Node>, kChildren> children;
+  };
+
+  // Whether the node itself holds the formula
+  [[nodiscard]] static auto Find(const Node &node, std::size_t hash,
+                                 const Formula &formula) -> bool;
+
+  [[nodiscard]] static auto Full(const Node &node, unsigned depth) -> bool {
+    return depth < kMaxDepth && node.entries.size() >= kNodeFormulas;
+  }
+  [[nodiscard]] static auto ChildOf(std::size_t hash, unsigned depth)
+      -> std::size_t {
+    return (hash >> (depth * kBits)) & (kChildren - 1);
+  }
+
+  std::shared_ptr<Node> root_{};
+  std::size_t size_{0};
+  uint64_t tree_bytes_{0};
+};
+
+template <typename Function>
+auto FormulaSet::ForEach(Function function) const -> void {
+  std::vector<const Node *> stack;
+  if (root_ != nullptr) {
+    stack.push_back(root_.get());
+  }
+  while (!stack.empty()) {
+    const auto *node = stack.back();
+    stack.pop_back();
+    for (const auto &entry : node->entries) {
+      function(entry.formula);
+    }
+    for (const auto &child : node->children) {
+      if (child != nullptr) {
+        stack.push_back(child.get());
+      }
+    }
+  }
+}
+
 class Theory {
 public:
   [[nodiscard]] auto Undecidable() const -> bool { return undecidable_; }
   [[nodiscard]] auto Close() const -> bool { return close_; }
 
-  explicit Theory(const TableauFormula &formula) { Append(formula); }
+  explicit Theory() = default;
+  // With propagation, the theory keeps its beta formulas indexed by their
+  // literal sides (see NextFormula)
+  explicit Theory(bool propagation) : propagation_{propagation} {}
+  explicit Theory(const TableauFormula &formula, bool propagation)
+      : propagation_{propagation} {
+    Append(formula);
+  }
+
+  // theories is cleared first, so that the caller can reuse its buffer
+  // Expandable => non-empty theories, and the theory is moved into it
+  // Un-expandable => empty theories, and the theory is left as it was
+  auto TryExpand(const TableauOptions &options, TableauStats &stats,
+                 std::vector<Theory> &theories) -> void;
+
+  // Return true if the formula is queued to be expanded (false for a
+  // literal, or a formula already queued on the branch)
+  auto Append(const TableauFormula &formula) -> bool;
 
-  // Expandable => non-empty vector
-  // Un-expandable => empty vector
-  auto TryExpand() -> std::vector<Theory>;
+  // Bytes of the theory, exprs included, as if it shared nothing with the
+  // other theories (see the definition for what it misses)
+  [[nodiscard]] auto ApproximateSize() const -> uint64_t;
 
-  auto Append(const TableauFormula &formula) -> void;
+  auto Serialize(std::string &out) const -> void;
+  [[nodiscard]] static auto Deserialize(std::string_view &in) -> Theory;
 
 private:
-  std::priority_queue<TableauFormula, std::vector<TableauFormula>,
-                      std::greater<>>
-      formulas_{};
-  std::unordered_set<Token> literals_{};
-  std::unordered_set<Token> neg_literals_{};
+  enum class LiteralStatus { kUnknown, kTrue, kFalse };
+
+  // Whether the formula is on the branch: one of its literals, or queued
+  // (universal formulas and negations are not found, see queued_)
+  [[nodiscard]] auto Contains(const Formula &formula) const -> bool;
+
+  // Whether an existential formula holds on the branch for one of its
+  // constants, so that it does not need a new one
+  [[nodiscard]] auto HasWitness(const TableauFormula &formula,
+                                TableauStats &stats) const -> bool;
+
+  // If the formula (or its negation) is a literal up to negations,
+  // its value on the branch
+  [[nodiscard]] auto Evaluate(const Formula &formula, bool negated) const
+      -> LiteralStatus;
+
+  // With propagation, index a beta formula just queued by the keys of its
+  // literal sides, or make it ready if one of them is on the branch already
+  auto Watch(const TableauFormula &formula) -> void;
+
+  // The next formula to expand: the top of the queue, or with propagation,
+  // a beta formula with a side already refuted or satisfied if there is one
+  // Nothing if only beta formulas expanded out of order were left
+  auto NextFormula() -> std::optional<TableauFormula>;
+
+  FormulaQueue formulas_{};
+  // keys of the literals of the branch (see LiteralTable)
+  std::unordered_set<LiteralTable::Key> literals_{};
+  std::unordered_set<LiteralTable::Key> neg_literals_{};
+
+  // formulas that have been queued on this branch, but universal formulas
+  // and negations (see Append)
+  FormulaSet queued_{};
+
+  // With propagation, the beta formulas of formulas_ by the keys of their
+  // literal sides, moved to ready_ once the key is on the branch
+  // A list is shared with the other branches until one of them appends to it
+  bool propagation_{false};
+  std::unordered_map<LiteralTable::Key,
+                     std::shared_ptr<std::vector<TableauFormula>>>
+      watches_{};
+  std::size_t watched_{0};
+  std::vector<TableauFormula> ready_{};
+  // beta formulas expanded so far, so that their other copies in formulas_
+  // and ready_ are skipped
+  FormulaSet expanded_{};
 
   ConstantManager manager_{};
   bool undecidable_{false};
@@ -56,6 +421,98 @@ class Tableau {
 public:
   enum class TableauResult { kUnsatisfiable, kSatisfiable, kUndecidable };
 
-  [[nodiscard]] static auto Solve(const Parser::ParserOutput &parser_out)
-      -> TableauResult;
+  class TableauOutput {
+  public:
+    explicit TableauOutput(TableauResult result, TableauStats stats)
+        : result_(result), stats_(stats) {}
+
+    [[nodiscard]] auto Result() const -> TableauResult { return result_; }
+    [[nodiscard]] auto Stats() const -> const TableauStats & { return stats_; }
+
+  private:
+    TableauResult result_;
+    TableauStats stats_;
+  };
+
+  [[nodiscard]] static auto Solve(const Parser::ParserOutput &parser_out,
+                                  const TableauOptions &options = {})
+      -> TableauOutput;
+};
+
+/*
+  Solve a stack of assertion levels, keeping the expansion work of every level
+  between queries
+
+  Each level owns the open theories of its branch frontier. Asserting a
+  formula appends it to every open theory of the current level (closing some
+  of them), and Check continues expanding from where the last Check stopped.
+  Push copies the current frontier into a new level, so popping it restores
+  the shared part exactly as it was expanded before.
+
+  An undecidable theory is set aside, like Tableau::Solve does, until an
+  assertion gives it a formula to expand: it then goes back to the frontier,
+  since the new formula may still close it. It stays undecidable otherwise.
+*/
+class IncrementalTableau {
+public:
+  explicit IncrementalTableau(const TableauOptions &options = {})
+      : options_{options}, levels_(1) {
+    levels_.back().frontier.emplace_back(options.propagation);
+  }
+
+  // Open a new level on top of the current one
+  auto Push() -> void;
+
+  // Drop the current level and all the assertions made in it
+  // The base level can not be popped
+  auto Pop() -> void;
+
+  auto Assert(const Formula &formula) -> void;
+
+  [[nodiscard]] auto Check() -> Tableau::TableauResult;
+
+  [[nodiscard]] auto Depth() const -> std::size_t { return levels_.size() - 1; }
+
+  // Accumulated over all the checks so far
+  [[nodiscard]] auto Stats() const -> const TableauStats & { return stats_; }
+
+private:
+  struct Level {
+    // open theories that may still be expanded
+    std::vector<Theory> frontier{};
+    // open theories that reached the constant limit
+    std::vector<Theory> undecidable{};
+    // formulas asserted but not yet appended to the theories
+    std::vector<TableauFormula> pending{};
+  };
+
+  auto Flush(Level &level) -> void;
+
+  TableauOptions options_;
+  TableauStats stats_{};
+  std::vector<Level> levels_;
 };
+
+template <typename Predicate>
+auto Expansion::RemoveBranchesIf(Predicate predicate) -> void {
+  std::size_t kept_branches{0};
+  std::size_t kept_formulas{0};
+  std::size_t begin{0};
+  for (std::size_t branch = 0; branch < ends_.Size(); ++branch) {
+    const auto end = ends_[branch];
+    // the formulas of the kept branches only move towards the front, so
+    // the ones of this branch are still in place
+    if (!predicate(
+            Branch{formulas_.Data() + begin, formulas_.Data() + end})) {
+      for (auto i = begin; i < end; ++i, ++kept_formulas) {
+        if (kept_formulas != i) {
+          formulas_[kept_formulas] = std::move(formulas_[i]);
+        }
+      }
+      ends_[kept_branches++] = kept_formulas;
+    }
+    begin = end;
+  }
+  formulas_.Truncate(kept_formulas);
+  ends_.Truncate(kept_branches);
+}
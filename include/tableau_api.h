@@ -0,0 +1,141 @@
+#ifndef TABLEAU_API_H
+#define TABLEAU_API_H
+
+/*
+  C API of the parser and the solver (libtableau.a / libtableau.so)
+
+  The types and functions below are only ever extended: new enumerators and
+  option fields are appended, and the library reads and writes only the
+  option fields that fit in the struct_size given by the caller, so code
+  built against an older header keeps working. No function throws or
+  aborts: failures are reported through the return value.
+*/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum tableau_kind {
+  TABLEAU_NOT_A_FORMULA = 0,
+  TABLEAU_PROPOSITION = 1,
+  TABLEAU_PREDICATE = 2
+} tableau_kind;
+
+typedef enum tableau_result {
+  TABLEAU_UNSATISFIABLE = 0,
+  TABLEAU_SATISFIABLE = 1,
+  TABLEAU_UNDECIDABLE = 2,
+  /*
+    the formula could not be solved (not a formula, out of memory, spill
+    file error, ...)
+  */
+  TABLEAU_ERROR = 3
+} tableau_result;
+
+/*
+  Same meaning as the options of the command line (see README.md)
+  struct_size must be set to sizeof(tableau_options) by the caller, before
+  tableau_options_init. The fields beyond it (appended after the header
+  the caller was built with) keep their default value.
+*/
+typedef struct tableau_options {
+  size_t struct_size;
+  uint64_t memory_budget;
+  int semantic_branching;
+  int propagation;
+  uint64_t free_variable_depth;
+  uint64_t model_finding_size;
+  int batch_gamma;
+  int reuse_constants;
+  int depth_first;
+  int portfolio;
+} tableau_options;
+
+/* Parsed formula */
+typedef struct tableau_formula tableau_formula;
+
+/*
+  Caller-provided memory for the handles, so that a service can parse many
+  formulas without going through malloc: tableau_arena_create places the
+  arena at the start of buffer, and the handles parsed with it are bumped
+  after it. When the buffer is full, handles fall back to the heap.
+  The parse trees themselves always live on the heap.
+*/
+typedef struct tableau_arena tableau_arena;
+
+/*
+  Default options (the ones of the command line without flags), for the
+  fields that fit in options->struct_size
+*/
+void tableau_options_init(tableau_options *options);
+
+/* NULL if buffer is too small to hold the arena itself */
+tableau_arena *tableau_arena_create(void *buffer, size_t size);
+
+/*
+  Reuse the whole buffer
+  The handles parsed with the arena must be freed before
+*/
+void tableau_arena_reset(tableau_arena *arena);
+
+/*
+  Parse the formula of length bytes (no NUL needed)
+  arena may be NULL. Return NULL on failure (e.g. out of memory).
+*/
+tableau_formula *tableau_parse(const char *text, size_t length,
+                               tableau_arena *arena);
+
+/*
+  Incremental parser of one formula given in chunks of any size, e.g. the
+  blocks of a large file, which do not need to end between tokens
+  The text is not kept unless keep_text != 0, so tableau_describe writes
+  nothing for a formula that is not one.
+*/
+typedef struct tableau_parser tableau_parser;
+
+/* Return NULL on failure (e.g. out of memory) */
+tableau_parser *tableau_parser_create(int keep_text);
+
+/*
+  Return 0 on failure (e.g. out of memory), then the formula is not a formula
+  (the parser must still be finished)
+*/
+int tableau_parser_feed(tableau_parser *parser, const char *chunk,
+                        size_t length);
+
+/*
+  Release the parser and return the formula fed to it, placed in arena as
+  tableau_parse does (arena may be NULL). Return NULL on failure.
+*/
+tableau_formula *tableau_parser_finish(tableau_parser *parser,
+                                       tableau_arena *arena);
+
+tableau_kind tableau_formula_kind(const tableau_formula *formula);
+
+/*
+  options may be NULL (default options)
+  Return TABLEAU_ERROR if options->struct_size is too small for any field
+*/
+tableau_result tableau_solve(const tableau_formula *formula,
+                             const tableau_options *options);
+
+/*
+  Write the description of the formula (the raw text if it is not a
+  formula) into buffer, truncated to size - 1 bytes and NUL-terminated
+  if size > 0
+  Return the length of the full description, as snprintf does
+*/
+size_t tableau_describe(const tableau_formula *formula, char *buffer,
+                        size_t size);
+
+/* Release the handle (formula may be NULL) */
+void tableau_free(tableau_formula *formula);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TABLEAU_API_H */
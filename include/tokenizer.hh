@@ -2,12 +2,14 @@
 
 #include <cstddef>
 #include <string>
+#include <string_view>
 
 class Token {
 public:
   explicit Token() = default;
   explicit Token(std::string token) : token_{std::move(token)} {}
   [[nodiscard]] auto ToString() const -> std::string { return token_; }
+  [[nodiscard]] auto View() const -> std::string_view { return token_; }
 
 private:
   std::string token_{};
@@ -28,32 +30,3 @@ template <> struct hash<Token> {
   }
 };
 } // namespace std
-
-class Tokenizer {
-public:
-  explicit Tokenizer(std::string expr) : expr_{std::move(expr)} {
-    ConsumeWhitespace();
-  }
-
-  [[nodiscard]] auto PeekToken() const -> Token {
-    return Token{std::string{expr_[start_]}};
-  }
-
-  void PopToken() {
-    ++start_;
-    ConsumeWhitespace();
-  }
-
-  [[nodiscard]] auto Empty() const -> bool {
-    return start_ == std::string::npos;
-  }
-
-private:
-  void ConsumeWhitespace() {
-    const static char *k_whitespaces = " \t\n\v\f\r";
-    start_ = expr_.find_first_not_of(k_whitespaces, start_);
-  }
-
-  std::string expr_;
-  std::string::size_type start_{0};
-};
\ No newline at end of file
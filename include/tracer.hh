@@ -0,0 +1,91 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+/*
+  Collect spans of the program and write them as Chrome trace events
+  (load the output in chrome://tracing or https://ui.perfetto.dev)
+
+  Spans are recorded through TraceSpan, only when a tracer is active.
+  To keep the trace of deep solves manageable
+    - spans nested deeper than max_depth are dropped
+    - sampled spans (e.g. one per rule application) are only kept once every
+      sample_every times on each thread
+*/
+class Tracer {
+public:
+  // sample_every == 0 is the same as 1 (keep all)
+  explicit Tracer(uint64_t max_depth, uint64_t sample_every)
+      : max_depth_{max_depth},
+        sample_every_{sample_every == 0 ? 1 : sample_every} {}
+
+  // The tracer used by TraceSpan (nullptr => tracing is disabled)
+  [[nodiscard]] static auto Active() -> Tracer * { return active_; }
+  static auto SetActive(Tracer *tracer) -> void { active_ = tracer; }
+
+  [[nodiscard]] auto MaxDepth() const -> uint64_t { return max_depth_; }
+  [[nodiscard]] auto SampleEvery() const -> uint64_t { return sample_every_; }
+
+  auto Record(const char *name, std::chrono::steady_clock::time_point start,
+              std::chrono::steady_clock::time_point end, std::string args)
+      -> void;
+
+  auto Write(std::ostream &out) const -> void;
+
+private:
+  struct Event {
+    const char *name;
+    double timestamp; // us since the tracer is created
+    double duration;  // us
+    uint64_t thread_id;
+    std::string args; // JSON members without the braces
+  };
+
+  inline static Tracer *active_{nullptr};
+
+  uint64_t max_depth_;
+  uint64_t sample_every_;
+  std::chrono::steady_clock::time_point epoch_{
+      std::chrono::steady_clock::now()};
+
+  mutable std::mutex mutex_{};
+  std::vector<Event> events_{};
+};
+
+// Record the lifetime of the span as one complete event of the active tracer
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name, bool sampled = false)
+      : tracer_{Tracer::Active()}, name_{name} {
+    if (tracer_ != nullptr) {
+      Begin(sampled);
+    }
+  }
+
+  ~TraceSpan();
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan(TraceSpan &&) = delete;
+  auto operator=(const TraceSpan &) -> TraceSpan & = delete;
+  auto operator=(TraceSpan &&) -> TraceSpan & = delete;
+
+  // Whether this span will be recorded
+  // Check it before building costly arguments
+  [[nodiscard]] auto Recording() const -> bool { return tracer_ != nullptr; }
+
+  // Shown in the details of the event
+  auto AddArgument(const char *key, const std::string &value) -> void;
+  auto AddArgument(const char *key, uint64_t value) -> void;
+
+private:
+  auto Begin(bool sampled) -> void;
+
+  Tracer *tracer_; // nullptr => this span is not recorded
+  const char *name_;
+  std::chrono::steady_clock::time_point start_{};
+  std::string args_{};
+};
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+/*
+  Vector whose first N elements are stored in the object itself, so that it
+  only allocates once it holds more than N elements
+
+  Beyond N, all the elements move to a std::vector, where they stay until
+  the InlineVector is emptied (Truncate(0) or Clear).
+*/
+template <typename T, std::size_t N> class InlineVector {
+public:
+  explicit InlineVector() = default;
+  ~InlineVector() { Clear(); }
+  InlineVector(const InlineVector &) = delete;
+  InlineVector(InlineVector &&) = delete;
+  auto operator=(const InlineVector &) -> InlineVector & = delete;
+  auto operator=(InlineVector &&) -> InlineVector & = delete;
+
+  [[nodiscard]] auto Empty() const -> bool { return size_ == 0; }
+  [[nodiscard]] auto Size() const -> std::size_t { return size_; }
+
+  [[nodiscard]] auto Data() -> T * {
+    return heap_.empty() ? Inline() : heap_.data();
+  }
+  [[nodiscard]] auto Data() const -> const T * {
+    return heap_.empty() ? Inline() : heap_.data();
+  }
+
+  [[nodiscard]] auto begin() -> T * { return Data(); }
+  [[nodiscard]] auto end() -> T * { return Data() + size_; }
+  [[nodiscard]] auto begin() const -> const T * { return Data(); }
+  [[nodiscard]] auto end() const -> const T * { return Data() + size_; }
+
+  [[nodiscard]] auto operator[](std::size_t i) -> T & { return Data()[i]; }
+  [[nodiscard]] auto operator[](std::size_t i) const -> const T & {
+    return Data()[i];
+  }
+
+  // Make room for capacity elements, which only allocates beyond N
+  auto Reserve(std::size_t capacity) -> void {
+    if (capacity <= N) {
+      return;
+    }
+    if (heap_.empty()) {
+      Spill(capacity);
+    } else {
+      heap_.reserve(capacity);
+    }
+  }
+
+  auto Push(T value) -> void {
+    if (heap_.empty() && size_ < N) {
+      new (Inline() + size_) T(std::move(value));
+      ++size_;
+      return;
+    }
+
+    if (heap_.empty()) {
+      Spill(2 * N);
+    }
+    heap_.push_back(std::move(value));
+    ++size_;
+  }
+
+  // Destroy the elements from size on
+  auto Truncate(std::size_t size) -> void {
+    if (size >= size_) {
+      return;
+    }
+    if (heap_.empty()) {
+      for (std::size_t i = size; i < size_; ++i) {
+        Inline()[i].~T();
+      }
+    } else {
+      heap_.erase(heap_.begin() + static_cast<std::ptrdiff_t>(size),
+                  heap_.end());
+    }
+    size_ = size;
+  }
+
+  auto Clear() -> void { Truncate(0); }
+
+private:
+  // Move the inline elements to heap_
+  auto Spill(std::size_t capacity) -> void {
+    heap_.reserve(capacity);
+    for (std::size_t i = 0; i < size_; ++i) {
+      heap_.push_back(std::move(Inline()[i]));
+      Inline()[i].~T();
+    }
+  }
+
+  [[nodiscard]] auto Inline() -> T * {
+    return std::launder(reinterpret_cast<T *>(storage_));
+  }
+  [[nodiscard]] auto Inline() const -> const T * {
+    return std::launder(reinterpret_cast<const T *>(storage_));
+  }
+
+  alignas(T) unsigned char storage_[N * sizeof(T)]{};
+  std::size_t size_{0};
+  // all the elements once there are more than N of them
+  std::vector<T> heap_{};
+};
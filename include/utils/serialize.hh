@@ -0,0 +1,41 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+// Raw (host byte order) encoding of integers and strings
+// The bytes are only read back by the same process, e.g. spilled theories
+
+inline auto WriteInteger(std::string &out, uint64_t value) -> void {
+  std::array<char, sizeof(value)> bytes{};
+  std::memcpy(bytes.data(), &value, sizeof(value));
+  out.append(bytes.data(), bytes.size());
+}
+
+// Overwrite an integer written before at pos
+inline auto PatchInteger(std::string &out, std::string::size_type pos,
+                         uint64_t value) -> void {
+  std::memcpy(&out[pos], &value, sizeof(value));
+}
+
+inline auto ReadInteger(std::string_view &in) -> uint64_t {
+  uint64_t value{0};
+  std::memcpy(&value, in.data(), sizeof(value));
+  in.remove_prefix(sizeof(value));
+  return value;
+}
+
+inline auto WriteString(std::string &out, const std::string &value) -> void {
+  WriteInteger(out, value.size());
+  out += value;
+}
+
+inline auto ReadString(std::string_view &in) -> std::string {
+  const auto size = ReadInteger(in);
+  std::string value{in.substr(0, size)};
+  in.remove_prefix(size);
+  return value;
+}
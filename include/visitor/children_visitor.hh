@@ -5,6 +5,7 @@
 
 #include "exprs/binary.hh"
 #include "exprs/literal.hh"
+#include "exprs/nary.hh"
 #include "exprs/unary.hh"
 
 #include "expr_visitor.hh"
@@ -30,6 +31,10 @@ public:
     children_.push_back(binary.expr_rhs_);
   }
 
+  auto Visit(const NaryExpr &nary) -> void final {
+    children_.insert(children_.end(), nary.exprs_.begin(), nary.exprs_.end());
+  }
+
   auto ChildrenSize() -> std::vector<std::shared_ptr<Expr>>::size_type {
     return children_.size();
   }
@@ -5,6 +5,7 @@ struct PredicateLiteral;
 struct UnaryExpr;
 struct QuantifiedUnaryExpr;
 struct BinaryExpr;
+struct NaryExpr;
 
 class ExprVisitor {
 public:
@@ -13,6 +14,7 @@ public:
   virtual void Visit(const UnaryExpr &unary) = 0;
   virtual void Visit(const QuantifiedUnaryExpr &quantified) = 0;
   virtual void Visit(const BinaryExpr &binary) = 0;
+  virtual void Visit(const NaryExpr &nary) = 0;
 
   ExprVisitor() = default;
   virtual ~ExprVisitor() = default;
@@ -5,6 +5,7 @@
 
 #include "exprs/binary.hh"
 #include "exprs/literal.hh"
+#include "exprs/nary.hh"
 #include "exprs/unary.hh"
 
 #include "expr_visitor.hh"
@@ -29,6 +30,8 @@ public:
 
   auto Visit(const BinaryExpr &binary) -> void final { (void)binary; }
 
+  auto Visit(const NaryExpr &nary) -> void final { (void)nary; }
+
   auto Infos() -> std::vector<Token> & { return infos_; }
 
 private:
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+/*
+  Buffered output of the results
+
+  Everything is formatted into one reusable buffer, which is handed to the
+  file descriptor with a few large write calls once it is full. Unlike
+  std::cout, nothing is synchronized with stdio and no temporary string is
+  needed (see Buffer).
+*/
+class Writer {
+public:
+  // fd < 0 => keep the output in the buffer (see Take), which then only
+  // grows with what is written, as it is usually one short record
+  explicit Writer(int fd = -1) : fd_{fd} {
+    if (fd_ >= 0) {
+      buffer_.reserve(kCapacity);
+    }
+  }
+
+  // Flush the buffer
+  ~Writer();
+  Writer(const Writer &) = delete;
+  Writer(Writer &&) = delete;
+  auto operator=(const Writer &) -> Writer & = delete;
+  auto operator=(Writer &&) -> Writer & = delete;
+
+  auto operator<<(std::string_view text) -> Writer & {
+    buffer_ += text;
+    return *this;
+  }
+
+  auto operator<<(char c) -> Writer & {
+    buffer_ += c;
+    return *this;
+  }
+
+  auto operator<<(uint64_t value) -> Writer &;
+
+  // Format directly at the end of the buffer, e.g. with
+  // Formula::AppendDescription
+  auto Buffer() -> std::string & { return buffer_; }
+
+  // Flush the buffer if it is full
+  // Call it between records, so that a record is written at once
+  auto EndRecord() -> void {
+    if (buffer_.size() >= kCapacity) {
+      Flush();
+    }
+  }
+
+  // Write the whole buffer to the file descriptor
+  // Return false if a write failed (then the output is dropped)
+  auto Flush() -> bool;
+
+  // Move out the buffer of a writer without file descriptor
+  [[nodiscard]] auto Take() -> std::string;
+
+private:
+  static constexpr std::size_t kCapacity{1U << 16U};
+
+  int fd_;
+  std::string buffer_{};
+  bool good_{true};
+};
@@ -0,0 +1,135 @@
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#if defined(__APPLE__)
+#include <malloc/malloc.h>
+#else
+#include <malloc.h>
+#endif
+
+#include "alloc_profiler.hh"
+
+namespace {
+// Counters of this thread, by phase
+// (constant-initialized, so they can be used by operator new at any time)
+thread_local AllocationProfiler::PhaseCounters counters{};
+thread_local AllocationProfiler::Phase current_phase{
+    AllocationProfiler::Phase::kOther};
+// Bytes allocated minus bytes freed by this thread (negative if it frees
+// blocks allocated by other threads)
+thread_local int64_t live{0};
+// The most live bytes since the innermost scope started
+thread_local int64_t scope_peak{0};
+
+// Bytes usable in a block returned by malloc (at least the requested size)
+// Counting these rather than the requested size lets ProfiledFree update
+// live without storing the size in front of every block
+auto BlockSize(void *block) -> std::size_t {
+#if defined(__APPLE__)
+  return malloc_size(block);
+#else
+  return malloc_usable_size(block);
+#endif
+}
+
+auto Index(AllocationProfiler::Phase phase) -> std::size_t {
+  return static_cast<std::size_t>(phase);
+}
+
+// Count a block returned by malloc (thrown as bad_alloc if nullptr)
+auto CountAllocation(void *block) -> void * {
+  if (block == nullptr) {
+    throw std::bad_alloc{};
+  }
+
+  if (AllocationProfiler::Enabled()) {
+    const auto block_size = BlockSize(block);
+    auto &phase_counters = counters[Index(current_phase)];
+    ++phase_counters.allocations;
+    phase_counters.bytes += block_size;
+    live += static_cast<int64_t>(block_size);
+    scope_peak = std::max(scope_peak, live);
+  }
+  return block;
+}
+} // namespace
+
+auto AllocationProfiler::Counters::operator+=(const Counters &other)
+    -> Counters & {
+  allocations += other.allocations;
+  bytes += other.bytes;
+  frees += other.frees;
+  peak_bytes = std::max(peak_bytes, other.peak_bytes);
+  return *this;
+}
+
+auto AllocationProfiler::Take() -> PhaseCounters {
+  const auto taken = counters;
+  counters = {};
+  return taken;
+}
+
+auto AllocationProfiler::PhaseName(Phase phase) -> const char * {
+  switch (phase) {
+  case Phase::kOther:
+    return "other";
+  case Phase::kParse:
+    return "parse";
+  case Phase::kDescribe:
+    return "describe";
+  case Phase::kExpand:
+    return "expand";
+  case Phase::kSubstitute:
+    return "substitute";
+  case Phase::kTheoryCopy:
+    return "theory_copy";
+  case Phase::kDestroy:
+    return "destroy";
+  }
+  return "";
+}
+
+auto AllocationScope::Begin(AllocationProfiler::Phase phase) -> void {
+  active_ = true;
+  previous_phase_ = current_phase;
+  current_phase = phase;
+  start_live_ = live;
+  previous_peak_ = scope_peak;
+  scope_peak = live;
+}
+
+auto AllocationScope::End() -> void {
+  auto &peak_bytes = counters[Index(current_phase)].peak_bytes;
+  peak_bytes =
+      std::max(peak_bytes, static_cast<uint64_t>(scope_peak - start_live_));
+  current_phase = previous_phase_;
+  // the peak of this scope is also reached in the enclosing one
+  scope_peak = std::max(previous_peak_, scope_peak);
+}
+
+auto ProfiledAllocate(std::size_t size) -> void * {
+  // malloc(0) may return nullptr, whereas operator new may not
+  return CountAllocation(std::malloc(size == 0 ? 1 : size));
+}
+
+auto ProfiledAllocate(std::size_t size, std::size_t alignment) -> void * {
+  // posix_memalign wants a multiple of sizeof(void *)
+  void *block = nullptr;
+  if (posix_memalign(&block, std::max(alignment, sizeof(void *)),
+                     size == 0 ? 1 : size) != 0) {
+    block = nullptr;
+  }
+  return CountAllocation(block);
+}
+
+auto ProfiledFree(void *pointer) -> void {
+  if (pointer == nullptr) {
+    return;
+  }
+  if (AllocationProfiler::Enabled()) {
+    ++counters[Index(current_phase)].frees;
+    live -= static_cast<int64_t>(BlockSize(pointer));
+  }
+  std::free(pointer);
+}
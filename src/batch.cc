@@ -0,0 +1,97 @@
+#include <algorithm>
+#include <utility>
+
+#include "batch.hh"
+
+BatchRunner::BatchRunner(uint64_t jobs, Writer &out, Writer &err)
+    : out_{out}, err_{err} {
+  if (jobs == 0) {
+    jobs = std::max(1U, std::thread::hardware_concurrency());
+  }
+  window_ = jobs * kWindowPerJob;
+
+  workers_.reserve(jobs);
+  for (uint64_t i = 0; i < jobs; ++i) {
+    workers_.emplace_back([this] { Work(); });
+  }
+}
+
+BatchRunner::~BatchRunner() { Finish(); }
+
+auto BatchRunner::Submit(Task task) -> void {
+  std::unique_lock lock{mutex_};
+  tasks_.emplace_back(written_ + outputs_.size(), std::move(task));
+  outputs_.emplace_back();
+  work_cv_.notify_one();
+
+  Emit(lock, true);
+}
+
+auto BatchRunner::Drain() -> void {
+  std::unique_lock lock{mutex_};
+  const auto window = std::exchange(window_, 1);
+  Emit(lock, true);
+  window_ = window;
+}
+
+auto BatchRunner::Finish() -> void {
+  Drain();
+
+  std::unique_lock lock{mutex_};
+  if (stopping_) {
+    return;
+  }
+
+  stopping_ = true;
+  lock.unlock();
+  work_cv_.notify_all();
+  for (auto &worker : workers_) {
+    worker.join();
+  }
+}
+
+auto BatchRunner::Work() -> void {
+  std::unique_lock lock{mutex_};
+  while (true) {
+    work_cv_.wait(lock, [this] { return stopping_ || !tasks_.empty(); });
+    if (tasks_.empty()) {
+      return;
+    }
+
+    auto [index, task] = std::move(tasks_.front());
+    tasks_.pop_front();
+
+    lock.unlock();
+    auto output = task();
+    lock.lock();
+
+    outputs_[index - written_] = std::move(output);
+    if (index == written_) {
+      done_cv_.notify_one();
+    }
+  }
+}
+
+auto BatchRunner::Emit(std::unique_lock<std::mutex> &lock, bool wait)
+    -> void {
+  while (!outputs_.empty()) {
+    if (!outputs_.front().has_value()) {
+      if (!wait || outputs_.size() < window_) {
+        return;
+      }
+      done_cv_.wait(lock, [this] { return outputs_.front().has_value(); });
+    }
+
+    // Only this thread pops the outputs, so the write can be done unlocked
+    auto output = std::move(*outputs_.front());
+    outputs_.pop_front();
+    ++written_;
+
+    lock.unlock();
+    out_ << output.out;
+    err_ << output.err;
+    out_.EndRecord();
+    err_.EndRecord();
+    lock.lock();
+  }
+}
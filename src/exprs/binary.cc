@@ -17,6 +17,7 @@ auto BinaryExpr::Append(std::shared_ptr<Expr> expr) -> void {
   }
 
   expr_rhs_ = std::move(expr);
+  Summarize();
 }
 
 auto BinaryExpr::Append(ExprKind type) -> void {
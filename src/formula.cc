@@ -1,17 +1,26 @@
+#include <algorithm>
 #include <cassert>
 #include <cstddef>
+#include <iterator>
 #include <stack>
 #include <utility>
 #include <vector>
 
+#include "alloc_profiler.hh"
+#include "exprs/binary.hh"
 #include "exprs/expr.hh"
+#include "exprs/literal.hh"
+#include "exprs/nary.hh"
+#include "exprs/unary.hh"
 #include "formula.hh"
+#include "tracer.hh"
 #include "utils/helper.hh"
+#include "utils/serialize.hh"
 #include "visitor/children_visitor.hh"
 #include "visitor/info_visitor.hh"
 
 namespace {
-auto TypeToString(ExprKind type) -> std::string {
+auto TypeToString(ExprKind type) -> std::string_view {
   switch (type) {
   case ExprKind::kAnd:
     return "^";
@@ -39,9 +48,13 @@ auto LiteralDescription(const Expr *expr, std::string &out, uint64_t num)
     expr->Accept(visitor);
 
     const auto &infos = visitor.Infos();
-    out += infos[0].ToString();
+    out += infos[0].View();
     if (infos.size() == 3) {
-      out += "(" + infos[1].ToString() + "," + infos[2].ToString() + ")";
+      out += '(';
+      out += infos[1].View();
+      out += ',';
+      out += infos[2].View();
+      out += ')';
     }
   }
 }
@@ -54,26 +67,29 @@ auto UnaryDescription(const Expr *expr, std::string &out, uint64_t num)
     if (type == ExprKind::kExist || type == ExprKind::kUniversal) {
       InfoVisitor visitor;
       expr->Accept(visitor);
-      out += visitor.Infos()[0].ToString();
+      out += visitor.Infos()[0].View();
     }
   }
 }
 
-auto BinaryDescription(const Expr *expr, std::string &out, uint64_t num)
-    -> void {
+// An NaryExpr is written with the connective between all its children,
+// e.g. (p^q^r)
+auto BinaryDescription(const Expr *expr, std::string &out, uint64_t num,
+                       std::size_t children) -> void {
   if (num == 0) {
     out += "(";
-  } else if (num == 1) {
+  } else if (num < children) {
     out += TypeToString(expr->Type());
-  } else if (num == 2) {
+  } else {
     out += ")";
   }
 }
 
-auto Description(const Expr *expr, std::string &out, uint64_t num) -> void {
+auto Description(const Expr *expr, std::string &out, uint64_t num,
+                 std::size_t children) -> void {
   const auto type = expr->Type();
   if (ExprKind::IsBinary(type)) {
-    BinaryDescription(expr, out, num);
+    BinaryDescription(expr, out, num, children);
   } else if (ExprKind::IsUnary(type)) {
     UnaryDescription(expr, out, num);
   } else if (ExprKind::IsLiteral(type)) {
@@ -81,34 +97,34 @@ auto Description(const Expr *expr, std::string &out, uint64_t num) -> void {
   }
 }
 
+// Added to the type of an NaryExpr by Serialize, which then writes the
+// number of children (the other exprs have a fixed number of children)
+constexpr uint64_t kNaryFlag{1U << 8U};
+
 // Add all the left child into the stack
 //
 // Left child is defined as
 //  - no left child for literal
 //  - the only child of the UnaryExpr
-//  - the left child of the BinaryExpr
+//  - the left child of the BinaryExpr (the first child of the NaryExpr)
 auto ExpandLeft(std::stack<std::pair<Expr *, uint64_t>> &stack,
                 std::string &out, Expr *expr) -> void {
   while (true) {
-    ::Description(expr, out, 0);
-    stack.emplace(expr, 1);
-
     ChildrenVisitor children_visitor;
     expr->Accept(children_visitor);
 
-    switch (children_visitor.ChildrenSize()) {
-    case 0:
+    ::Description(expr, out, 0, children_visitor.ChildrenSize());
+    stack.emplace(expr, 1);
+
+    if (children_visitor.ChildrenSize() == 0) {
       return;
-    case 1:
-      [[fallthrough]];
-    case 2:
-      expr = children_visitor.ViewChildren()[0].get();
     }
+    expr = children_visitor.ViewChildren()[0].get();
   }
 }
 } // namespace
 
-[[nodiscard]] auto Formula::Connective() const -> std::string {
+[[nodiscard]] auto Formula::Connective() const -> std::string_view {
   return TypeToString(expr_->Type());
 }
 
@@ -121,32 +137,40 @@ auto ExpandLeft(std::stack<std::pair<Expr *, uint64_t>> &stack,
 
   So, we design a modified iterative in-order traversal where
   each expr has at most three stages (0, 1, 2 children are visited).
+  An NaryExpr has one more stage per additional child, where the connective
+  is written again.
   After all children are processed, it will be pop out of the stack
 */
 auto Formula::Description() const -> std::string {
+  std::string out;
+  AppendDescription(out);
+  return out;
+}
+
+auto Formula::AppendDescription(std::string &out) const -> void {
+  const TraceSpan span{"Formula::Description"};
+  const AllocationScope allocation_scope{AllocationProfiler::Phase::kDescribe};
+
   // Expr*, uint64_t pair => uint64_t stores number of children visited
   std::stack<std::pair<Expr *, uint64_t>> stack;
-  std::string out;
 
   ExpandLeft(stack, out, expr_.get());
   while (!stack.empty()) {
     const auto [expr, num] = stack.top();
     stack.pop();
 
-    ::Description(expr, out, num);
-
     ChildrenVisitor children_visitor;
     expr->Accept(children_visitor);
 
-    // Only BinaryExpr falls into this case
-    // because it has ChildrenSize == 2
+    ::Description(expr, out, num, children_visitor.ChildrenSize());
+
+    // Only BinaryExpr and NaryExpr fall into this case
+    // because they have ChildrenSize >= 2
     if (num < children_visitor.ChildrenSize()) {
       stack.emplace(expr, num + 1);
       ExpandLeft(stack, out, children_visitor.ViewChildren()[num].get());
     }
   }
-
-  return out;
 }
 
 auto Formula::ViewChildren() const -> std::vector<Formula> {
@@ -160,6 +184,288 @@ auto Formula::ViewChildren() const -> std::vector<Formula> {
   return ret;
 }
 
+auto Formula::ViewInfos() const -> std::vector<Token> {
+  InfoVisitor info_visitor;
+  expr_->Accept(info_visitor);
+  return std::move(info_visitor.Infos());
+}
+
+/*
+  Post-order traversal, where the operands of an expr are
+    - the operands of the whole chain for ^ and v: the children are replaced
+      by their own children as long as they have the same connective
+    - the children otherwise
+
+  The exprs are rebuilt once all their operands are flattened, unless
+  nothing changed below them. The subtrees without a chain (see
+  Expr::HasChain) are not visited at all, so that a formula without any
+  is returned as it is.
+*/
+auto Formula::FlattenConnectives() const -> Formula {
+  if (!expr_->HasChain()) {
+    return *this;
+  }
+
+  struct Frame {
+    std::shared_ptr<Expr> expr;
+    std::vector<std::shared_ptr<Expr>> operands;
+    std::size_t next; // operands already flattened
+    bool merged;      // operands come from more than one expr
+  };
+
+  std::vector<Frame> frames;
+  std::vector<std::shared_ptr<Expr>> flattened;
+
+  const auto push = [&frames](std::shared_ptr<Expr> expr) {
+    Frame frame{std::move(expr), {}, 0, false};
+    const auto type = frame.expr->Type();
+
+    ChildrenVisitor children_visitor;
+    frame.expr->Accept(children_visitor);
+    auto &pending = children_visitor.ViewChildren();
+    std::reverse(pending.begin(), pending.end());
+
+    const bool associative = type == ExprKind::kAnd || type == ExprKind::kOr;
+    while (!pending.empty()) {
+      auto child = std::move(pending.back());
+      pending.pop_back();
+      if (associative && child->Type() == type) {
+        ChildrenVisitor chain_visitor;
+        child->Accept(chain_visitor);
+        const auto &chain = chain_visitor.ViewChildren();
+        pending.insert(pending.end(), chain.rbegin(), chain.rend());
+        frame.merged = true;
+      } else {
+        frame.operands.push_back(std::move(child));
+      }
+    }
+    frames.push_back(std::move(frame));
+  };
+
+  push(expr_);
+  while (!frames.empty()) {
+    auto &frame = frames.back();
+    if (frame.next < frame.operands.size()) {
+      auto &operand = frame.operands[frame.next++];
+      if (operand->HasChain()) {
+        push(operand);
+      } else {
+        flattened.push_back(operand);
+      }
+      continue;
+    }
+
+    const auto size = frame.operands.size();
+    const auto first =
+        flattened.end() - static_cast<std::ptrdiff_t>(size);
+    std::shared_ptr<Expr> expr;
+    if (!frame.merged && std::equal(first, flattened.end(),
+                                    frame.operands.begin())) {
+      expr = std::move(frame.expr);
+    } else {
+      const auto type = frame.expr->Type();
+      if (size > 2) {
+        expr = std::make_shared<NaryExpr>(
+            type, std::vector(std::make_move_iterator(first),
+                              std::make_move_iterator(flattened.end())));
+      } else if (size == 2) {
+        expr = std::make_shared<BinaryExpr>(type, std::move(first[0]),
+                                            std::move(first[1]));
+      } else if (type == ExprKind::kNeg) {
+        expr = std::make_shared<UnaryExpr>(type, std::move(first[0]));
+      } else {
+        InfoVisitor info_visitor;
+        frame.expr->Accept(info_visitor);
+        expr = std::make_shared<QuantifiedUnaryExpr>(
+            type, std::move(info_visitor.Infos()[0]), std::move(first[0]));
+      }
+    }
+
+    flattened.resize(flattened.size() - size);
+    flattened.push_back(std::move(expr));
+    frames.pop_back();
+  }
+
+  return Formula{std::move(flattened.back())};
+}
+
+auto Formula::ViewLiteral(uint64_t max_negations) const -> LiteralView {
+  LiteralView view;
+  const Expr *expr = expr_.get();
+  while (expr->Type() == ExprKind::kNeg) {
+    if (view.negations == max_negations) {
+      return view;
+    }
+    expr = static_cast<const UnaryExpr *>(expr)->expr_.get();
+    ++view.negations;
+  }
+  if (ExprKind::IsLiteral(expr->Type())) {
+    view.literal = true;
+    view.key = static_cast<const Literal *>(expr)->key_;
+  }
+  return view;
+}
+
+/*
+  Every expr is written as its type, followed by its infos (see InfoVisitor)
+
+  Post-order lets Deserialize rebuild the tree with a single stack: all the
+  children of an expr are already built when the expr is read.
+  An NaryExpr is also followed by its number of children (see kNaryFlag).
+*/
+auto Formula::Serialize(std::string &out) const -> void {
+  const auto count_pos = out.size();
+  WriteInteger(out, 0);
+  uint64_t count{0};
+
+  // Expr*, number of children pair => 0 children means that the children
+  // are not written yet (or that there are none)
+  std::stack<std::pair<Expr *, std::size_t>> stack;
+  stack.emplace(expr_.get(), 0);
+
+  while (!stack.empty()) {
+    const auto [expr, children_size] = stack.top();
+    stack.pop();
+
+    if (children_size == 0) {
+      ChildrenVisitor children_visitor;
+      expr->Accept(children_visitor);
+      const auto &children = children_visitor.ViewChildren();
+      if (!children.empty()) {
+        stack.emplace(expr, children.size());
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+          stack.emplace(it->get(), 0);
+        }
+        continue;
+      }
+    }
+
+    InfoVisitor info_visitor;
+    expr->Accept(info_visitor);
+    const auto &infos = info_visitor.Infos();
+
+    const auto type = static_cast<uint64_t>(expr->Type());
+    if (children_size > 2) {
+      WriteInteger(out, type | kNaryFlag);
+      WriteInteger(out, children_size);
+    } else {
+      WriteInteger(out, type);
+    }
+    WriteInteger(out, infos.size());
+    for (const auto &info : infos) {
+      WriteString(out, info.ToString());
+    }
+    ++count;
+  }
+
+  PatchInteger(out, count_pos, count);
+}
+
+auto Formula::Deserialize(std::string_view &in) -> Formula {
+  std::vector<std::shared_ptr<Expr>> stack;
+
+  for (auto count = ReadInteger(in); count > 0; --count) {
+    const auto value = ReadInteger(in);
+    const ExprKind type{
+        static_cast<ExprKind::ExprKindInternal>(value & ~kNaryFlag)};
+    const auto children_size = (value & kNaryFlag) != 0 ? ReadInteger(in) : 0;
+
+    std::vector<Token> infos(ReadInteger(in));
+    for (auto &info : infos) {
+      info = Token{ReadString(in)};
+    }
+
+    std::shared_ptr<Expr> expr;
+    if (ExprKind::IsLiteral(type)) {
+      expr = infos.size() == 3
+                 ? std::make_shared<PredicateLiteral>(std::move(infos[0]),
+                                                      std::move(infos[1]),
+                                                      std::move(infos[2]))
+                 : std::make_shared<Literal>(std::move(infos[0]));
+    } else if (children_size > 2) {
+      std::vector<std::shared_ptr<Expr>> children(
+          std::make_move_iterator(stack.end() -
+                                  static_cast<std::ptrdiff_t>(children_size)),
+          std::make_move_iterator(stack.end()));
+      stack.resize(stack.size() - children_size);
+      expr = std::make_shared<NaryExpr>(type, std::move(children));
+    } else if (ExprKind::IsBinary(type)) {
+      auto rhs = std::move(stack.back());
+      stack.pop_back();
+      auto lhs = std::move(stack.back());
+      stack.pop_back();
+      expr = std::make_shared<BinaryExpr>(type, std::move(lhs), std::move(rhs));
+    } else if (type == ExprKind::kNeg) {
+      auto child = std::move(stack.back());
+      stack.pop_back();
+      expr = std::make_shared<UnaryExpr>(type, std::move(child));
+    } else {
+      auto child = std::move(stack.back());
+      stack.pop_back();
+      expr = std::make_shared<QuantifiedUnaryExpr>(type, std::move(infos[0]),
+                                                   std::move(child));
+    }
+
+    stack.push_back(std::move(expr));
+  }
+
+  assert(stack.size() == 1);
+  return Formula{std::move(stack.back())};
+}
+
+auto operator==(const Formula &lhs, const Formula &rhs) -> bool {
+  if (lhs.expr_ == rhs.expr_) {
+    return true;
+  }
+  if (lhs.Hash() != rhs.Hash()) {
+    return false;
+  }
+
+  std::vector<std::pair<const Expr *, const Expr *>> stack{
+      {lhs.expr_.get(), rhs.expr_.get()}};
+  while (!stack.empty()) {
+    const auto [lhs_expr, rhs_expr] = stack.back();
+    stack.pop_back();
+
+    if (lhs_expr == rhs_expr) {
+      continue;
+    }
+    if (lhs_expr->Type() != rhs_expr->Type()) {
+      return false;
+    }
+    if (ExprKind::IsLiteral(lhs_expr->Type())) {
+      if (static_cast<const Literal *>(lhs_expr)->key_ !=
+          static_cast<const Literal *>(rhs_expr)->key_) {
+        return false;
+      }
+      continue;
+    }
+
+    InfoVisitor lhs_info_visitor;
+    InfoVisitor rhs_info_visitor;
+    lhs_expr->Accept(lhs_info_visitor);
+    rhs_expr->Accept(rhs_info_visitor);
+    if (lhs_info_visitor.Infos() != rhs_info_visitor.Infos()) {
+      return false;
+    }
+
+    ChildrenVisitor lhs_children_visitor;
+    ChildrenVisitor rhs_children_visitor;
+    lhs_expr->Accept(lhs_children_visitor);
+    rhs_expr->Accept(rhs_children_visitor);
+    const auto &lhs_children = lhs_children_visitor.ViewChildren();
+    const auto &rhs_children = rhs_children_visitor.ViewChildren();
+    if (lhs_children.size() != rhs_children.size()) {
+      return false;
+    }
+    for (decltype(lhs_children.size()) i = 0; i < lhs_children.size(); ++i) {
+      stack.emplace_back(lhs_children[i].get(), rhs_children[i].get());
+    }
+  }
+
+  return true;
+}
+
 /*
   Relying on the destructor of Expr is dangerous, as it may
     - cause stack overflow if the Expr is long enough
@@ -172,6 +478,13 @@ auto Formula::ViewChildren() const -> std::vector<Formula> {
       so we don't need to destruct it
 */
 Formula::~Formula() {
+  // Moved from, or the exprs are still owned by other formulas (e.g. the
+  // temporaries of a rule application): nothing to destroy here
+  if (expr_ == nullptr || expr_.use_count() != 1) {
+    return;
+  }
+
+  const AllocationScope allocation_scope{AllocationProfiler::Phase::kDestroy};
   std::vector<std::shared_ptr<Expr>> destruct_queue;
   destruct_queue.push_back(std::move(expr_));
 
@@ -0,0 +1,507 @@
+#include <algorithm>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "constant.hh"
+#include "free_variable.hh"
+
+namespace {
+// Limits of one attempt at a given depth
+constexpr uint64_t kMaxBranches{4096};
+constexpr uint64_t kMaxSearchSteps{100000};
+
+/*
+  Terms are stored in the tokens of the predicates
+    - "X<n>" is a free variable
+    - "#<n>" is a Skolem term, whose symbol and arguments are kept by Terms
+    - anything else is a constant (e.g. a variable that is free in the input)
+*/
+auto IsVariable(const std::string &term) -> bool { return term[0] == 'X'; }
+auto IsSkolem(const std::string &term) -> bool { return term[0] == '#'; }
+
+class Terms {
+public:
+  auto FreshVariable() -> Token {
+    return Token{"X" + std::to_string(variables_++)};
+  }
+
+  // The Skolem term of the existential formula applied to args
+  auto Skolem(const Formula &formula, std::vector<std::string> args) -> Token {
+    const auto symbol =
+        symbols_.try_emplace(formula, symbols_.size()).first->second;
+    auto key = std::pair{symbol, std::move(args)};
+
+    auto it = ids_.find(key);
+    if (it == ids_.end()) {
+      it = ids_.emplace(key, terms_.size()).first;
+      terms_.push_back(std::move(key));
+    }
+    return Token{"#" + std::to_string(it->second)};
+  }
+
+  [[nodiscard]] auto Symbol(const std::string &term) const -> uint64_t {
+    return terms_[std::stoull(term.substr(1))].first;
+  }
+
+  [[nodiscard]] auto Args(const std::string &term) const
+      -> const std::vector<std::string> & {
+    return terms_[std::stoull(term.substr(1))].second;
+  }
+
+private:
+  uint64_t variables_{0};
+  std::unordered_map<Formula, uint64_t> symbols_{};
+  std::map<std::pair<uint64_t, std::vector<std::string>>, uint64_t> ids_{};
+  std::vector<std::pair<uint64_t, std::vector<std::string>>> terms_{};
+};
+
+// Free variables of the formula, including the ones in its Skolem terms
+auto FreeVariables(const Formula &formula, const Terms &terms)
+    -> std::vector<std::string> {
+  std::vector<std::string> variables;
+  std::vector<Formula> stack{formula};
+
+  while (!stack.empty()) {
+    const auto top = std::move(stack.back());
+    stack.pop_back();
+
+    if (!ExprKind::IsLiteral(top.Type())) {
+      for (auto &child : top.ViewChildren()) {
+        stack.push_back(std::move(child));
+      }
+      continue;
+    }
+
+    const auto infos = top.ViewInfos();
+    for (decltype(infos.size()) i = 1; i < infos.size(); ++i) {
+      auto term = infos[i].ToString();
+      if (IsVariable(term)) {
+        variables.push_back(std::move(term));
+      } else if (IsSkolem(term)) {
+        const auto &args = terms.Args(term);
+        variables.insert(variables.end(), args.begin(), args.end());
+      }
+    }
+  }
+
+  std::sort(variables.begin(), variables.end());
+  variables.erase(std::unique(variables.begin(), variables.end()),
+                  variables.end());
+  return variables;
+}
+
+enum class Truth { kFalse, kTrue, kUnknown };
+
+/*
+  Value of the formula in the empty domain: every universal formula holds
+  and no existential formula does, while the literals outside of the
+  quantifiers are left unknown (so the value may be unknown as well)
+*/
+auto InEmptyDomain(const Formula &formula) -> Truth {
+  // Formula, bool pair => bool stores whether the children were pushed
+  std::vector<std::pair<Formula, bool>> stack{{formula, false}};
+  // values of the children of the formulas on the stack, in order
+  std::vector<Truth> values;
+
+  while (!stack.empty()) {
+    auto [top, children_pushed] = std::move(stack.back());
+    stack.pop_back();
+
+    const auto type = top.Type();
+    if (type == ExprKind::kUniversal || type == ExprKind::kExist) {
+      values.push_back(type == ExprKind::kUniversal ? Truth::kTrue
+                                                    : Truth::kFalse);
+      continue;
+    }
+    if (ExprKind::IsLiteral(type)) {
+      values.push_back(Truth::kUnknown);
+      continue;
+    }
+
+    const auto children = top.ViewChildren();
+    if (!children_pushed) {
+      stack.emplace_back(std::move(top), true);
+      for (auto it = children.rbegin(); it != children.rend(); ++it) {
+        stack.emplace_back(*it, false);
+      }
+      continue;
+    }
+
+    const auto first = values.end() - static_cast<std::ptrdiff_t>(
+                                          children.size());
+    const auto negate = [](Truth value) {
+      return value == Truth::kUnknown
+                 ? value
+                 : (value == Truth::kTrue ? Truth::kFalse : Truth::kTrue);
+    };
+    Truth value{};
+    if (type == ExprKind::kNeg) {
+      value = negate(*first);
+    } else {
+      // (A>B) is (-AvB), and (AvB) is -(-A^-B)
+      if (type == ExprKind::kImpl) {
+        *first = negate(*first);
+      }
+      const bool conjunction = type == ExprKind::kAnd;
+      const auto absorbing = conjunction ? Truth::kFalse : Truth::kTrue;
+      const auto neutral = conjunction ? Truth::kTrue : Truth::kFalse;
+      value = neutral;
+      for (auto it = first; it != values.end() && value != absorbing; ++it) {
+        value = *it == neutral ? value : *it;
+      }
+    }
+    values.erase(first, values.end());
+    values.push_back(value);
+  }
+
+  return values.back();
+}
+
+// Substitution built by unification, with a trail to undo bindings
+class Unifier {
+public:
+  explicit Unifier(const Terms &terms) : terms_{terms} {}
+
+  // Extend the substitution to unify lhs and rhs
+  // On failure, the substitution may be partially extended (see Undo)
+  auto Unify(const std::string &lhs, const std::string &rhs) -> bool {
+    std::vector<std::pair<std::string, std::string>> work{{lhs, rhs}};
+
+    while (!work.empty()) {
+      auto [left, right] = std::move(work.back());
+      work.pop_back();
+
+      left = Walk(left);
+      right = Walk(right);
+      if (left == right) {
+        continue;
+      }
+
+      if (IsVariable(right)) {
+        std::swap(left, right);
+      }
+
+      if (IsVariable(left)) {
+        if (Occurs(left, right)) {
+          return false;
+        }
+        trail_.push_back(left);
+        bindings_.emplace(std::move(left), std::move(right));
+        continue;
+      }
+
+      // Constants only unify with themselves,
+      // Skolem terms need the same symbol (hence the same arity)
+      if (!IsSkolem(left) || !IsSkolem(right) ||
+          terms_.Symbol(left) != terms_.Symbol(right)) {
+        return false;
+      }
+
+      const auto &left_args = terms_.Args(left);
+      const auto &right_args = terms_.Args(right);
+      for (decltype(left_args.size()) i = 0; i < left_args.size(); ++i) {
+        work.emplace_back(left_args[i], right_args[i]);
+      }
+    }
+
+    return true;
+  }
+
+  [[nodiscard]] auto Mark() const -> std::size_t { return trail_.size(); }
+
+  // Remove the bindings made after mark
+  auto Undo(std::size_t mark) -> void {
+    while (trail_.size() > mark) {
+      bindings_.erase(trail_.back());
+      trail_.pop_back();
+    }
+  }
+
+private:
+  // Follow the bindings of a variable
+  [[nodiscard]] auto Walk(std::string term) const -> std::string {
+    for (auto it = bindings_.find(term); it != bindings_.end();
+         it = bindings_.find(term)) {
+      term = it->second;
+    }
+    return term;
+  }
+
+  // Whether variable occurs in term (under the substitution)
+  [[nodiscard]] auto Occurs(const std::string &variable,
+                            const std::string &term) const -> bool {
+    std::vector<std::string> stack{term};
+    while (!stack.empty()) {
+      const auto top = Walk(std::move(stack.back()));
+      stack.pop_back();
+
+      if (top == variable) {
+        return true;
+      }
+      if (IsSkolem(top)) {
+        const auto &args = terms_.Args(top);
+        stack.insert(stack.end(), args.begin(), args.end());
+      }
+    }
+    return false;
+  }
+
+  const Terms &terms_;
+  std::unordered_map<std::string, std::string> bindings_{};
+  std::vector<std::string> trail_{};
+};
+
+struct Atom {
+  std::string predicate;
+  std::string left;
+  std::string right;
+  bool negated;
+};
+
+struct Branch {
+  std::vector<TableauFormula> pending{};
+  // universal formulas with the number of times they are instantiated
+  std::vector<std::pair<TableauFormula, uint64_t>> gammas{};
+  std::vector<Atom> atoms{};
+  // formulas already added to the branch: they are expanded only once
+  std::unordered_set<Formula> queued{};
+};
+
+// Return false if the formula closes the branch without any substitution
+auto Append(Branch &branch, const TableauFormula &formula) -> bool {
+  const auto type = formula.Type();
+
+  Formula literal = formula;
+  const bool negated = type == ExprKind::kNeg &&
+                       ExprKind::IsLiteral(formula.ViewChildren()[0].Type());
+  if (negated) {
+    literal = formula.ViewChildren()[0];
+  }
+
+  if (ExprKind::IsLiteral(literal.Type())) {
+    auto infos = literal.ViewInfos();
+    infos.resize(3);
+    Atom atom{infos[0].ToString(), infos[1].ToString(), infos[2].ToString(),
+              negated};
+
+    if (std::any_of(branch.atoms.begin(), branch.atoms.end(),
+                    [&atom](const Atom &other) {
+                      return other.negated != atom.negated &&
+                             other.predicate == atom.predicate &&
+                             other.left == atom.left &&
+                             other.right == atom.right;
+                    })) {
+      return false;
+    }
+
+    branch.atoms.push_back(std::move(atom));
+    return true;
+  }
+
+  if (!branch.queued.insert(formula).second) {
+    return true;
+  }
+
+  if (type == ExprKind::kUniversal) {
+    branch.gammas.emplace_back(formula, 0);
+  } else {
+    branch.pending.push_back(formula);
+  }
+  return true;
+}
+
+/*
+  Expand the tableau of the formula, instantiating every universal formula
+  at most depth times per branch
+
+  The branches that are still open are stored into open
+  Return false if there are too many branches
+*/
+auto ExpandAll(const Formula &formula, uint64_t depth, Terms &terms,
+               const TableauOptions &options, TableauStats &stats,
+               std::vector<Branch> &open) -> bool {
+  ConstantManager manager;
+  std::vector<Branch> work;
+  uint64_t branches{1};
+
+  Branch root;
+  if (Append(root, TableauFormula{formula})) {
+    work.push_back(std::move(root));
+  }
+
+  while (!work.empty()) {
+    Branch branch = std::move(work.back());
+    work.pop_back();
+
+    if (!branch.pending.empty()) {
+      auto next = std::move(branch.pending.back());
+      branch.pending.pop_back();
+
+      Expansion expansions;
+      if (next.Type() == ExprKind::kExist) {
+        ++stats.delta.count;
+        expansions.AddBranch();
+        expansions.Add(next.Instantiate(
+            terms.Skolem(next, FreeVariables(next, terms)), stats));
+      } else {
+        const auto type = next.Type();
+        auto &rule = type == ExprKind::kAnd   ? stats.alpha
+                     : type == ExprKind::kNeg ? stats.negation
+                                              : stats.beta;
+        ++rule.count;
+        next.Expand(manager, options, stats, expansions);
+      }
+
+      const auto new_branches = expansions.Branches();
+      branches += new_branches - 1;
+      stats.branches_created += new_branches - 1;
+      if (branches > kMaxBranches) {
+        return false;
+      }
+
+      for (std::size_t i = 0; i < new_branches; ++i) {
+        const auto expansion = expansions[i];
+        Branch new_branch = i + 1 == new_branches ? std::move(branch) : branch;
+        if (std::all_of(expansion.begin(), expansion.end(),
+                        [&new_branch](const TableauFormula &new_formula) {
+                          return Append(new_branch, new_formula);
+                        })) {
+          work.push_back(std::move(new_branch));
+        } else {
+          ++stats.branches_closed;
+        }
+      }
+      continue;
+    }
+
+    // Instantiate the universal formula used the least (fairness)
+    auto gamma =
+        std::min_element(branch.gammas.begin(), branch.gammas.end(),
+                         [](const auto &lhs, const auto &rhs) {
+                           return lhs.second < rhs.second;
+                         });
+    if (gamma != branch.gammas.end() && gamma->second < depth) {
+      ++gamma->second;
+      ++stats.gamma.count;
+      if (Append(branch,
+                 gamma->first.Instantiate(terms.FreshVariable(), stats))) {
+        work.push_back(std::move(branch));
+      } else {
+        ++stats.branches_closed;
+      }
+      continue;
+    }
+
+    open.push_back(std::move(branch));
+  }
+
+  return true;
+}
+
+/*
+  Look for one substitution that closes all the branches
+
+  Depth-first search over the complementary pairs of every branch, where
+  each choice extends the substitution of the previous branches
+*/
+auto CloseAll(const std::vector<Branch> &branches, const Terms &terms) -> bool {
+  // complementary pairs (same predicate) of every branch
+  std::vector<std::vector<std::pair<const Atom *, const Atom *>>> candidates;
+  for (const auto &branch : branches) {
+    auto &pairs = candidates.emplace_back();
+    for (const auto &positive : branch.atoms) {
+      for (const auto &negative : branch.atoms) {
+        if (!positive.negated && negative.negated &&
+            positive.predicate == negative.predicate) {
+          pairs.emplace_back(&positive, &negative);
+        }
+      }
+    }
+    if (pairs.empty()) {
+      return false;
+    }
+  }
+
+  // Fail early: most constrained branches first
+  std::sort(candidates.begin(), candidates.end(),
+            [](const auto &lhs, const auto &rhs) {
+              return lhs.size() < rhs.size();
+            });
+
+  struct Frame {
+    std::size_t branch;
+    std::size_t candidate;
+    std::size_t mark;
+  };
+
+  Unifier unifier{terms};
+  std::vector<Frame> stack{{0, 0, unifier.Mark()}};
+  uint64_t steps{0};
+
+  while (!stack.empty()) {
+    const auto index = stack.size() - 1;
+    if (stack[index].branch == candidates.size()) {
+      return true;
+    }
+
+    const auto &pairs = candidates[stack[index].branch];
+    bool unified{false};
+    while (!unified && stack[index].candidate < pairs.size()) {
+      if (++steps > kMaxSearchSteps) {
+        return false;
+      }
+
+      unifier.Undo(stack[index].mark);
+      const auto [positive, negative] = pairs[stack[index].candidate++];
+      unified = unifier.Unify(positive->left, negative->left) &&
+                unifier.Unify(positive->right, negative->right);
+    }
+
+    if (!unified) {
+      unifier.Undo(stack[index].mark);
+      stack.pop_back();
+      continue;
+    }
+
+    stack.push_back({stack[index].branch + 1, 0, unifier.Mark()});
+  }
+
+  return false;
+}
+} // namespace
+
+auto FreeVariableTableau::Refute(const Formula &formula, uint64_t max_depth,
+                                 const TableauOptions &options,
+                                 TableauStats &stats) -> bool {
+  // The ground tableau allows an empty domain, where this tableau proves
+  // nothing: the formula must also be false there
+  if (InEmptyDomain(formula) != Truth::kFalse) {
+    return false;
+  }
+
+  for (uint64_t depth = 1; depth <= max_depth && !options.Cancelled();
+       ++depth) {
+    Terms terms;
+    std::vector<Branch> open;
+    if (!ExpandAll(formula, depth, terms, options, stats, open)) {
+      return false;
+    }
+
+    if (open.empty() || CloseAll(open, terms)) {
+      return true;
+    }
+
+    // Without universal formulas, going deeper yields the same tableau
+    if (std::none_of(open.begin(), open.end(), [](const Branch &branch) {
+          return !branch.gammas.empty();
+        })) {
+      return false;
+    }
+  }
+
+  return false;
+}
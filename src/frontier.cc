@@ -0,0 +1,111 @@
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "frontier.hh"
+#include "utils/serialize.hh"
+
+Frontier::~Frontier() {
+  if (spill_file_ != nullptr) {
+    std::fclose(spill_file_);
+  }
+}
+
+/*
+  A theory goes to the spill file if
+    - some theories are already spilled (they are older, so they must be
+      popped first)
+    - or keeping it in memory would exceed the budget
+
+  If the spill file can not be used, we keep the theory in memory: the
+  search is still correct, it only loses the FIFO order
+*/
+auto Frontier::Push(Theory theory) -> void {
+  const auto size = theory.ApproximateSize();
+
+  if (memory_budget_ != 0 && !depth_first_ &&
+      (spilled_ != 0 || memory_bytes_ + size > memory_budget_) &&
+      Spill(theory)) {
+    ++spilled_;
+    return;
+  }
+
+  memory_bytes_ += size;
+  memory_.push_back(std::move(theory));
+}
+
+auto Frontier::Pop() -> Theory {
+  if (memory_.empty()) {
+    Refill();
+  }
+
+  Theory theory =
+      std::move(depth_first_ ? memory_.back() : memory_.front());
+  if (depth_first_) {
+    memory_.pop_back();
+  } else {
+    memory_.pop_front();
+  }
+  memory_bytes_ -= theory.ApproximateSize();
+  return theory;
+}
+
+// Each record is the size of the serialized theory followed by the theory
+auto Frontier::Spill(const Theory &theory) -> bool {
+  if (spill_file_ == nullptr) {
+    spill_file_ = std::tmpfile();
+    if (spill_file_ == nullptr) {
+      return false;
+    }
+  }
+
+  std::string record;
+  WriteInteger(record, 0);
+  theory.Serialize(record);
+  PatchInteger(record, 0, record.size() - sizeof(uint64_t));
+
+  if (std::fseek(spill_file_, write_offset_, SEEK_SET) != 0 ||
+      std::fwrite(record.data(), 1, record.size(), spill_file_) !=
+          record.size()) {
+    return false;
+  }
+
+  write_offset_ += static_cast<long>(record.size());
+  return true;
+}
+
+auto Frontier::Refill() -> void {
+  if (std::fseek(spill_file_, read_offset_, SEEK_SET) != 0) {
+    throw std::runtime_error("failed to seek the spill file");
+  }
+
+  std::string record;
+  do {
+    record.resize(sizeof(uint64_t));
+    if (std::fread(record.data(), 1, record.size(), spill_file_) !=
+        record.size()) {
+      throw std::runtime_error("failed to read the spill file");
+    }
+
+    std::string_view header{record};
+    record.resize(ReadInteger(header));
+    if (std::fread(record.data(), 1, record.size(), spill_file_) !=
+        record.size()) {
+      throw std::runtime_error("failed to read the spill file");
+    }
+    read_offset_ += static_cast<long>(sizeof(uint64_t) + record.size());
+    --spilled_;
+
+    std::string_view in{record};
+    Theory theory = Theory::Deserialize(in);
+    memory_bytes_ += theory.ApproximateSize();
+    memory_.push_back(std::move(theory));
+  } while (spilled_ != 0 && memory_bytes_ < memory_budget_);
+
+  // All the spilled theories are read back => reuse the file from the start
+  if (spilled_ == 0) {
+    read_offset_ = 0;
+    write_offset_ = 0;
+  }
+}
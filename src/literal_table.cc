@@ -0,0 +1,103 @@
+#include <atomic>
+#include <cstdint>
+#include <limits>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+#include "literal_table.hh"
+
+namespace {
+struct Table {
+  std::shared_mutex mutex;
+  std::unordered_map<std::string, LiteralTable::Key> keys;
+  // keys given by Intern and not released yet
+  std::atomic<uint64_t> holders{0};
+  // incremented whenever keys may be emptied, so that the threads drop the
+  // keys they cached before
+  std::atomic<uint64_t> generation{0};
+};
+
+auto GlobalTable() -> Table & {
+  static Table table;
+  return table;
+}
+
+// Literal being looked up, reused to avoid an allocation per lookup
+thread_local std::string buffer;
+
+// Keys already looked up by this thread, so that the shared table is only
+// locked for the literals that are new to the thread
+thread_local std::unordered_map<std::string, LiteralTable::Key> cache;
+thread_local uint64_t cache_generation{0};
+
+auto InternBuffer() -> LiteralTable::Key {
+  auto &table = GlobalTable();
+  // Counted before reading the generation: if Release reads holders after
+  // this, it sees the key is held and keeps the table
+  table.holders.fetch_add(1);
+  if (const auto generation = table.generation.load();
+      generation != cache_generation) {
+    cache.clear();
+    cache_generation = generation;
+  }
+
+  if (const auto it = cache.find(buffer); it != cache.end()) {
+    return it->second;
+  }
+
+  LiteralTable::Key key{0};
+  {
+    const std::shared_lock lock{table.mutex};
+    const auto it = table.keys.find(buffer);
+    if (it != table.keys.end()) {
+      key = it->second;
+    }
+  }
+  if (key == 0) {
+    const std::unique_lock lock{table.mutex};
+    if (table.keys.size() == std::numeric_limits<LiteralTable::Key>::max()) {
+      table.holders.fetch_sub(1);
+      throw std::length_error{"too many literals"};
+    }
+    // 0 is never a key, so that it tells the lookup above found nothing
+    const auto next_key = static_cast<LiteralTable::Key>(table.keys.size() + 1);
+    key = table.keys.try_emplace(buffer, next_key).first->second;
+  }
+
+  cache.emplace(buffer, key);
+  return key;
+}
+} // namespace
+
+auto LiteralTable::Intern(std::string_view proposition) -> Key {
+  buffer.assign(proposition);
+  return InternBuffer();
+}
+
+auto LiteralTable::Intern(std::string_view predicate, std::string_view left,
+                          std::string_view right) -> Key {
+  buffer.assign(predicate);
+  buffer += '(';
+  buffer += left;
+  buffer += ',';
+  buffer += right;
+  buffer += ')';
+  return InternBuffer();
+}
+
+auto LiteralTable::Release() -> void {
+  auto &table = GlobalTable();
+  if (table.holders.fetch_sub(1) != 1) {
+    return;
+  }
+
+  const std::unique_lock lock{table.mutex};
+  table.generation.fetch_add(1);
+  // a Literal may have been built since the count reached 0
+  if (table.holders.load() == 0) {
+    table.keys.clear();
+  }
+}
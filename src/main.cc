@@ -1,107 +1,313 @@
 #include <cassert>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
 #include <fstream>
 #include <iostream>
+#include <mutex>
+#include <optional>
 #include <ostream>
 #include <sstream>
 #include <string>
+#include <string_view>
 
+#include <unistd.h>
+
+#include "alloc_profiler.hh"
+#include "batch.hh"
 #include "parser.hh"
+#include "report.hh"
+#include "result_cache.hh"
+#include "server.hh"
 #include "tableau.hh"
+#include "tracer.hh"
+#include "writer.hh"
 
-auto PrintParserInformation(std::ostream &out,
-                            const Parser::ParserOutput &parser_out) -> void {
-  const Parser::ParseResult result = parser_out.Result();
-  const Formula &formula = parser_out.GetFormula();
+auto PrintUsage(std::ostream &out, const char *program) -> void {
+  out << "Usage: ./" << program << " [options] filename\n"
+      << "Options:\n"
+      << "  --memory-budget=BYTES  spill pending theories to a temporary "
+         "file beyond BYTES\n"
+      << "  --stats                print solver statistics of every line "
+         "as JSON to stderr\n"
+      << "  --semantic-branching   split (AvB) into {A}, {-A, B}\n"
+      << "  --propagation          expand first the beta formulas that do "
+         "not need to split\n"
+      << "  --batch-gamma          instantiate a universal formula with all "
+         "the constants\n"
+      << "                         of the branch at once\n"
+      << "  --reuse-constants      expand an existential formula without a "
+         "new constant\n"
+      << "                         when the branch already has a witness\n"
+      << "  --depth-first          expand the most recent branch first\n"
+      << "  --portfolio            run several strategies on each formula at "
+         "once, and\n"
+      << "                         keep the first definite answer\n"
+      << "  --free-variables=N     first try to refute first order formulas "
+         "with a\n"
+      << "                         free-variable tableau (N instantiations "
+         "per universal)\n"
+      << "  --model-finding=N      when the tableau gives up on a first "
+         "order formula,\n"
+      << "                         look for a model of at most N elements\n"
+      << "  --jobs=N               solve N lines at a time (0 => one per "
+         "core, default 1)\n"
+      << "  --format=FORMAT        text (default) or tsv: one "
+         "tab-separated record per line\n"
+      << "  --serve=PATH           answer requests on the Unix socket PATH "
+         "(- for stdin)\n"
+      << "                         instead of reading a file\n"
+      << "  --cache=FILE           reuse the results stored in FILE, and "
+         "store the new ones\n"
+      << "  --alloc-stats=MODE     count the allocations of every phase, "
+         "and print them\n"
+      << "                         as JSON to stderr per line (MODE=line) "
+         "or in total\n"
+      << "  --trace=FILE           write a Chrome trace of the run to FILE\n"
+      << "  --trace-depth=N        only trace spans nested at most N deep "
+         "(default 3)\n"
+      << "  --trace-sample=N       only trace one rule application out of "
+         "N (default 1)\n";
+}
 
-  if (result == Parser::ParseResult::kNotAFormula) {
-    out << parser_out.RawFormula() << " is not a formula.\n";
-    return;
+// Parse "--name=value" into value
+// Return false if arg is not this option or value is not a number
+auto ParseOption(std::string_view arg, std::string_view name, uint64_t &value)
+    -> bool {
+  if (arg.substr(0, name.size()) != name) {
+    return false;
   }
+  arg.remove_prefix(name.size());
+  const auto *const end = arg.data() + arg.size();
+  const auto [ptr, ec] = std::from_chars(arg.data(), end, value);
+  return ec == std::errc{} && ptr == end && !arg.empty();
+}
 
-  const std::string &line = parser_out.GetFormula().Description();
-  const auto type = formula.Type();
+// Parse "--name=value" into value
+// Return false if arg is not this option
+auto ParseOption(std::string_view arg, std::string_view name,
+                 std::string &value) -> bool {
+  if (arg.substr(0, name.size()) != name) {
+    return false;
+  }
+  value = arg.substr(name.size());
+  return true;
+}
 
-  if (result == Parser::ParseResult::kProposition) {
-    if (ExprKind::IsLiteral(type)) {
-      out << line << " is a proposition.\n";
-      return;
-    }
-    if (ExprKind::IsUnary(type)) {
-      out << line << " is a negation of a propositional formula.\n";
-      return;
-    }
-    if (ExprKind::IsBinary(type)) {
-      out << line << " is a binary connective propositional formula. ";
-      std::vector children = formula.ViewChildren();
-      assert(children.size() == 2);
-      out << "Its left hand side is " << children[0].Description();
-      out << ", its connective is " << formula.Connective();
-      out << ", and its right hand side is " << children[1].Description();
-      out << ".\n";
-      return;
-    }
+// Trace the reads, as the file may be on a slow device
+auto ReadLine(std::istream &in, std::string &line) -> bool {
+  const TraceSpan span{"read"};
+  return static_cast<bool>(std::getline(in, line));
+}
+
+enum class OutputFormat { kText, kTsv };
+
+// Allocations of the lines (--alloc-stats), shared by the worker threads
+struct AllocationReport {
+  bool per_line{false};
+  std::mutex mutex{};
+  uint64_t lines{0};
+  AllocationProfiler::PhaseCounters total{};
+};
+
+// Parse and/or solve one line of the input file, and print the results
+auto ParseAndSolve(Writer &out, Writer &err, const std::string &line,
+                   uint64_t line_number, bool parse, bool solve,
+                   OutputFormat format, const TableauOptions &options,
+                   ResultCache *cache) -> void {
+  TraceSpan line_span{"line"};
+  line_span.AddArgument("line", line_number);
+
+  const bool text = format == OutputFormat::kText;
+  const auto parse_out = Parser::Parse(line);
+  if (parse && text) {
+    PrintParserInformation(out, parse_out);
   }
 
-  if (result == Parser::ParseResult::kPredicate) {
-    if (ExprKind::IsLiteral(type)) {
-      out << line << " is an atom.\n";
-      return;
-    }
-    if (type == ExprKind::kNeg) {
-      out << line << " is a negation of a first order logic formula.\n";
-      return;
-    }
-    if (type == ExprKind::kUniversal) {
-      out << line << " is a universally quantified formula.\n";
-      return;
-    }
-    if (type == ExprKind::kExist) {
-      out << line << " is an existentially quantified formula.\n";
-      return;
-    }
-    if (ExprKind::IsBinary(type)) {
-      out << line << " is a binary connective first order formula. ";
-      std::vector children = formula.ViewChildren();
-      assert(children.size() == 2);
-      out << "Its left hand side is " << children[0].Description();
-      out << ", its connective is " << formula.Connective();
-      out << ", and its right hand side is " << children[1].Description();
-      out << ".\n";
-      return;
+  std::optional<Tableau::TableauOutput> tableau_out;
+  uint64_t nanoseconds{0};
+  if (solve) {
+    if (parse_out.Result() == Parser::ParseResult::kNotAFormula) {
+      if (text) {
+        PrintParserInformation(out, parse_out);
+      }
+    } else {
+      const auto start = std::chrono::steady_clock::now();
+      if (cache == nullptr) {
+        tableau_out = Tableau::Solve(parse_out, options);
+      } else {
+        const auto key =
+            ResultCache::MakeKey(parse_out.GetFormula(), options);
+        if (const auto result = cache->Find(key); result.has_value()) {
+          TableauStats stats;
+          stats.cache_hits = 1;
+          tableau_out.emplace(*result, stats);
+        } else {
+          tableau_out = Tableau::Solve(parse_out, options);
+          cache->Insert(key, tableau_out->Result());
+        }
+      }
+      nanoseconds = static_cast<uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(
+              std::chrono::steady_clock::now() - start)
+              .count());
+      if (text) {
+        PrintTableauInformation(out, parse_out, tableau_out->Result());
+      }
+      line_span.AddArgument("result", ResultName(tableau_out->Result()));
     }
   }
+
+  if (!text) {
+    PrintRecord(out, line_number, parse_out, parse, tableau_out);
+  }
+
+  if (options.collect_stats) {
+    PrintStatistics(err, line_number, tableau_out, nanoseconds);
+  }
 }
 
-auto PrintTableauInformation(std::ostream &out,
-                             const Parser::ParserOutput &parser_out,
-                             const Tableau::TableauResult &tableau_out)
-    -> void {
-  const std::string &line = parser_out.GetFormula().Description();
-  switch (tableau_out) {
-  case Tableau::TableauResult::kUnsatisfiable:
-    out << line << " is not satisfiable.\n";
-    break;
-  case Tableau::TableauResult::kSatisfiable:
-    out << line << " is satisfiable.\n";
-    break;
-  case Tableau::TableauResult::kUndecidable:
-    out << line << " may or may not be satisfiable.\n";
-    break;
+// ParseAndSolve, counting its allocations if report is not nullptr
+// The line is processed on the calling thread, so its counters are exactly
+// the ones of the line
+auto ProcessLine(Writer &out, Writer &err, const std::string &line,
+                 uint64_t line_number, bool parse, bool solve,
+                 OutputFormat format, const TableauOptions &options,
+                 ResultCache *cache, AllocationReport *report) -> void {
+  if (report == nullptr) {
+    ParseAndSolve(out, err, line, line_number, parse, solve, format, options,
+                  cache);
+    return;
+  }
+
+  AllocationProfiler::Take();
+  ParseAndSolve(out, err, line, line_number, parse, solve, format, options,
+                cache);
+  const auto counters = AllocationProfiler::Take();
+
+  if (report->per_line) {
+    PrintAllocationStatistics(err, "line", line_number, counters);
+    return;
+  }
+  const std::lock_guard lock{report->mutex};
+  ++report->lines;
+  for (std::size_t i = 0; i < counters.size(); ++i) {
+    report->total[i] += counters[i];
   }
 }
 
 auto main(int argc, char *argv[]) -> int {
-  if (argc != 2) {
-    std::cout << "Usage: ./" << argv[0] << " filename\n";
+  const char *filename{nullptr};
+  TableauOptions options;
+  std::string trace_filename;
+  uint64_t trace_depth{3};
+  uint64_t trace_sample{1};
+  uint64_t jobs{1};
+  std::string format_name{"text"};
+  std::string serve_path;
+  std::string cache_path;
+  std::string alloc_stats;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg{argv[i]};
+    if (arg.substr(0, 2) != "--" && filename == nullptr) {
+      filename = argv[i];
+    } else if (arg == "--stats") {
+      options.collect_stats = true;
+    } else if (arg == "--semantic-branching") {
+      options.semantic_branching = true;
+    } else if (arg == "--propagation") {
+      options.propagation = true;
+    } else if (arg == "--batch-gamma") {
+      options.batch_gamma = true;
+    } else if (arg == "--reuse-constants") {
+      options.reuse_constants = true;
+    } else if (arg == "--depth-first") {
+      options.depth_first = true;
+    } else if (arg == "--portfolio") {
+      options.portfolio = true;
+    } else if (!ParseOption(arg, "--memory-budget=", options.memory_budget) &&
+               !ParseOption(arg, "--free-variables=",
+                            options.free_variable_depth) &&
+               !ParseOption(arg, "--model-finding=",
+                            options.model_finding_size) &&
+               !ParseOption(arg, "--jobs=", jobs) &&
+               !ParseOption(arg, "--format=", format_name) &&
+               !ParseOption(arg, "--serve=", serve_path) &&
+               !ParseOption(arg, "--cache=", cache_path) &&
+               !ParseOption(arg, "--alloc-stats=", alloc_stats) &&
+               !ParseOption(arg, "--trace=", trace_filename) &&
+               !ParseOption(arg, "--trace-depth=", trace_depth) &&
+               !ParseOption(arg, "--trace-sample=", trace_sample)) {
+      std::cerr << "Unknown option " << arg << "\n";
+      PrintUsage(std::cerr, argv[0]);
+      return 1;
+    }
+  }
+
+  if (format_name != "text" && format_name != "tsv") {
+    std::cerr << "Unknown format " << format_name << "\n";
+    PrintUsage(std::cerr, argv[0]);
+    return 1;
+  }
+  const auto format =
+      format_name == "tsv" ? OutputFormat::kTsv : OutputFormat::kText;
+
+  if (!alloc_stats.empty() && alloc_stats != "line" &&
+      alloc_stats != "total") {
+    std::cerr << "Unknown allocation statistics " << alloc_stats << "\n";
+    PrintUsage(std::cerr, argv[0]);
+    return 1;
+  }
+
+  if (!serve_path.empty()) {
+    Server server{options, jobs};
+    if (serve_path == "-") {
+      return server.Serve(STDIN_FILENO, STDOUT_FILENO) ? 0 : 1;
+    }
+    if (!server.Listen(serve_path)) {
+      std::cerr << "Failed to listen on " << serve_path << "\n";
+      return 1;
+    }
+    return 0;
+  }
+
+  if (filename == nullptr) {
+    PrintUsage(std::cout, argv[0]);
     return 0;
   }
 
-  std::ifstream file{argv[1]};
+  std::ifstream file{filename};
   if (!file) {
     std::cerr << "Failed to open the file\n";
     return 1;
   }
 
+  std::optional<ResultCache> cache;
+  if (!cache_path.empty()) {
+    cache.emplace(cache_path);
+    if (!cache->Load()) {
+      std::cerr << "Failed to read the cache " << cache_path << "\n";
+      return 1;
+    }
+  }
+  ResultCache *const cache_ptr = cache.has_value() ? &*cache : nullptr;
+
+  // Before the worker threads are started
+  std::optional<AllocationReport> allocations;
+  if (!alloc_stats.empty()) {
+    allocations.emplace();
+    allocations->per_line = alloc_stats == "line";
+    AllocationProfiler::SetEnabled(true);
+  }
+  AllocationReport *const allocations_ptr =
+      allocations.has_value() ? &*allocations : nullptr;
+
+  Tracer tracer{trace_depth, trace_sample};
+  if (!trace_filename.empty()) {
+    Tracer::SetActive(&tracer);
+  }
+
   bool parse{false};
   bool solve{false};
 
@@ -120,18 +326,57 @@ auto main(int argc, char *argv[]) -> int {
     }
   }
 
-  while (std::getline(file, line)) {
-    const auto parse_out = Parser::Parse(line);
-    if (parse) {
-      PrintParserInformation(std::cout, parse_out);
+  Writer out{STDOUT_FILENO};
+  Writer err{STDERR_FILENO};
+
+  // the header is the first line
+  uint64_t line_number{1};
+  if (jobs == 1) {
+    while (ReadLine(file, line)) {
+      ++line_number;
+      ProcessLine(out, err, line, line_number, parse, solve, format, options,
+                  cache_ptr, allocations_ptr);
+      out.EndRecord();
+      err.EndRecord();
     }
-    if (solve) {
-      if (parse_out.Result() == Parser::ParseResult::kNotAFormula) {
-        PrintParserInformation(std::cout, parse_out);
-        continue;
-      }
-      const auto tableau_result = Tableau::Solve(parse_out);
-      PrintTableauInformation(std::cout, parse_out, tableau_result);
+  } else {
+    // The lines are independent: solve them concurrently, and print the
+    // results in the order of the file
+    BatchRunner runner{jobs, out, err};
+    while (ReadLine(file, line)) {
+      ++line_number;
+      runner.Submit([line, line_number, parse, solve, format, &options,
+                     cache_ptr, allocations_ptr] {
+        Writer line_out;
+        Writer line_err;
+        ProcessLine(line_out, line_err, line, line_number, parse, solve,
+                    format, options, cache_ptr, allocations_ptr);
+        return BatchRunner::Output{line_out.Take(), line_err.Take()};
+      });
+    }
+    runner.Finish();
+  }
+
+  if (allocations.has_value() && !allocations->per_line) {
+    PrintAllocationStatistics(err, "lines", allocations->lines,
+                              allocations->total);
+  }
+
+  if (!out.Flush() || !err.Flush()) {
+    return 1;
+  }
+  if (cache.has_value() && !cache->Flush()) {
+    std::cerr << "Failed to write the cache " << cache_path << "\n";
+    return 1;
+  }
+
+  if (!trace_filename.empty()) {
+    Tracer::SetActive(nullptr);
+    std::ofstream trace_file{trace_filename};
+    tracer.Write(trace_file);
+    if (!trace_file) {
+      std::cerr << "Failed to write the trace\n";
+      return 1;
     }
   }
   return 0;
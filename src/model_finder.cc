@@ -0,0 +1,356 @@
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "model_finder.hh"
+
+namespace {
+// Limits of the attempt at one domain size
+constexpr uint64_t kMaxGroundNodes{1U << 21U};
+constexpr uint64_t kMaxConflicts{100000};
+
+// Literal of the ground formula: variable * 2, plus 1 if negated
+using Literal = uint32_t;
+
+auto MakeLiteral(uint32_t variable, bool negated) -> Literal {
+  return variable * 2 + (negated ? 1 : 0);
+}
+auto Negation(Literal literal) -> Literal { return literal ^ 1U; }
+auto VariableOf(Literal literal) -> uint32_t { return literal >> 1U; }
+
+struct Cnf {
+  uint32_t variables{0};
+  std::vector<std::vector<Literal>> clauses{};
+};
+
+// Domain elements of the quantified variables, innermost first
+struct Binding {
+  std::string variable;
+  uint64_t element;
+  std::shared_ptr<const Binding> next;
+};
+
+/*
+  Ground the formula over a domain of the given size, into clauses
+
+  Negations are pushed down to the predicates, and every connective of the
+  ground formula gets a variable g that implies it, e.g. g -> (a v b) for a
+  disjunction. Since the connectives only occur positively, the converse
+  implications are not needed to preserve satisfiability.
+*/
+class Grounder {
+public:
+  explicit Grounder(uint64_t size) : size_{size} {}
+
+  // Add the clauses of formula to cnf
+  // Return false if formula has free variables or is too large
+  auto Ground(const Formula &formula, Cnf &cnf) -> bool {
+    struct Task {
+      Formula formula;
+      bool negated;
+      std::shared_ptr<const Binding> bindings;
+      bool expanded;
+    };
+
+    std::vector<Task> tasks{{formula, false, nullptr, false}};
+    std::vector<Literal> results;
+    uint64_t nodes{0};
+
+    while (!tasks.empty()) {
+      auto task = std::move(tasks.back());
+      tasks.pop_back();
+
+      if (++nodes > kMaxGroundNodes) {
+        return false;
+      }
+
+      const auto type = task.formula.Type();
+
+      if (task.expanded) {
+        const bool universal = type == ExprKind::kUniversal;
+        const bool quantified = universal || type == ExprKind::kExist;
+        const bool conjunction =
+            (type == ExprKind::kAnd || universal) != task.negated;
+
+        const std::size_t count =
+            quantified ? size_ : task.formula.ViewChildren().size();
+        const std::vector<Literal> children(results.end() - count,
+                                            results.end());
+        results.resize(results.size() - count);
+        results.push_back(Gate(children, conjunction, cnf));
+        continue;
+      }
+
+      if (ExprKind::IsLiteral(type)) {
+        const auto atom = Atom(task.formula, task.bindings.get(), cnf);
+        if (!atom.has_value()) {
+          return false;
+        }
+        results.push_back(MakeLiteral(*atom, task.negated));
+        continue;
+      }
+
+      auto children = task.formula.ViewChildren();
+      if (type == ExprKind::kNeg) {
+        tasks.push_back({std::move(children[0]), !task.negated,
+                         std::move(task.bindings), false});
+        continue;
+      }
+
+      tasks.push_back({task.formula, task.negated, task.bindings, true});
+
+      if (ExprKind::IsBinary(type)) {
+        // (A>B) is (-AvB)
+        tasks.push_back({std::move(children[0]),
+                         task.negated != (type == ExprKind::kImpl),
+                         task.bindings, false});
+        for (std::size_t i = 1; i < children.size(); ++i) {
+          tasks.push_back(
+              {std::move(children[i]), task.negated, task.bindings, false});
+        }
+        continue;
+      }
+
+      auto variable = task.formula.ViewInfos()[0].ToString();
+      for (uint64_t element = 0; element < size_; ++element) {
+        tasks.push_back({children[0], task.negated,
+                         std::make_shared<const Binding>(
+                             Binding{variable, element, task.bindings}),
+                         false});
+      }
+    }
+
+    cnf.clauses.push_back({results.back()});
+    return true;
+  }
+
+private:
+  // Variable of the ground predicate, nullopt if an argument is free
+  auto Atom(const Formula &literal, const Binding *bindings, Cnf &cnf)
+      -> std::optional<uint32_t> {
+    const auto infos = literal.ViewInfos();
+
+    std::string key = infos[0].ToString();
+    for (decltype(infos.size()) i = 1; i < infos.size(); ++i) {
+      const auto argument = infos[i].ToString();
+      const auto *binding = bindings;
+      while (binding != nullptr && binding->variable != argument) {
+        binding = binding->next.get();
+      }
+      if (binding == nullptr) {
+        return std::nullopt;
+      }
+      key += (i == 1 ? '(' : ',') + std::to_string(binding->element);
+    }
+
+    const auto [it, inserted] =
+        atoms_.try_emplace(std::move(key), cnf.variables);
+    if (inserted) {
+      ++cnf.variables;
+    }
+    return it->second;
+  }
+
+  static auto Gate(const std::vector<Literal> &children, bool conjunction,
+                   Cnf &cnf) -> Literal {
+    if (children.size() == 1) {
+      return children[0];
+    }
+
+    const auto gate = MakeLiteral(cnf.variables++, false);
+    if (conjunction) {
+      for (const auto child : children) {
+        cnf.clauses.push_back({Negation(gate), child});
+      }
+    } else {
+      auto &clause = cnf.clauses.emplace_back();
+      clause.push_back(Negation(gate));
+      clause.insert(clause.end(), children.begin(), children.end());
+    }
+    return gate;
+  }
+
+  uint64_t size_;
+  std::unordered_map<std::string, uint32_t> atoms_{};
+};
+
+/*
+  DPLL with two watched literals per clause
+
+  Decisions assign false first, which also leaves the unneeded gates off,
+  and conflicts backtrack chronologically to the last decision whose
+  other value has not been tried yet.
+*/
+class Solver {
+public:
+  enum class Result { kSatisfiable, kUnsatisfiable, kUnknown };
+
+  explicit Solver(Cnf cnf)
+      : clauses_{std::move(cnf.clauses)}, values_(cnf.variables, kUnassigned),
+        watches_(2 * static_cast<std::size_t>(cnf.variables)) {}
+
+  auto Solve(uint64_t max_conflicts) -> Result {
+    for (uint32_t index = 0; index < clauses_.size(); ++index) {
+      const auto &clause = clauses_[index];
+      if (clause.size() == 1) {
+        if (IsFalse(clause[0])) {
+          return Result::kUnsatisfiable;
+        }
+        if (!IsTrue(clause[0])) {
+          Assign(clause[0]);
+        }
+        continue;
+      }
+      watches_[clause[0]].push_back(index);
+      watches_[clause[1]].push_back(index);
+    }
+
+    uint64_t conflicts{0};
+    while (true) {
+      if (!Propagate()) {
+        if (++conflicts > max_conflicts) {
+          return Result::kUnknown;
+        }
+
+        while (!decisions_.empty() && decisions_.back().flipped) {
+          Undo(decisions_.back().trail_size);
+          decisions_.pop_back();
+        }
+        if (decisions_.empty()) {
+          return Result::kUnsatisfiable;
+        }
+
+        auto &decision = decisions_.back();
+        Undo(decision.trail_size);
+        decision.flipped = true;
+        Assign(Negation(decision.literal));
+        continue;
+      }
+
+      while (next_ < values_.size() && values_[next_] != kUnassigned) {
+        ++next_;
+      }
+      if (next_ == values_.size()) {
+        return Result::kSatisfiable;
+      }
+
+      const auto literal = MakeLiteral(next_, true);
+      decisions_.push_back({trail_.size(), literal, false});
+      Assign(literal);
+    }
+  }
+
+private:
+  static constexpr int8_t kUnassigned{-1};
+
+  struct Decision {
+    std::size_t trail_size;
+    Literal literal;
+    bool flipped;
+  };
+
+  [[nodiscard]] auto IsTrue(Literal literal) const -> bool {
+    const auto value = values_[VariableOf(literal)];
+    return value != kUnassigned && (value != 0) != ((literal & 1U) != 0);
+  }
+
+  [[nodiscard]] auto IsFalse(Literal literal) const -> bool {
+    return values_[VariableOf(literal)] != kUnassigned && !IsTrue(literal);
+  }
+
+  auto Assign(Literal literal) -> void {
+    values_[VariableOf(literal)] = (literal & 1U) == 0 ? 1 : 0;
+    trail_.push_back(literal);
+  }
+
+  auto Undo(std::size_t trail_size) -> void {
+    while (trail_.size() > trail_size) {
+      const auto variable = VariableOf(trail_.back());
+      values_[variable] = kUnassigned;
+      next_ = std::min(next_, variable);
+      trail_.pop_back();
+    }
+    head_ = std::min(head_, trail_size);
+  }
+
+  // Return false on conflict
+  auto Propagate() -> bool {
+    while (head_ < trail_.size()) {
+      const auto falsified = Negation(trail_[head_++]);
+      auto &watches = watches_[falsified];
+
+      std::size_t kept{0};
+      for (std::size_t i = 0; i < watches.size(); ++i) {
+        const auto index = watches[i];
+        auto &clause = clauses_[index];
+        if (clause[0] == falsified) {
+          std::swap(clause[0], clause[1]);
+        }
+
+        if (IsTrue(clause[0])) {
+          watches[kept++] = index;
+          continue;
+        }
+
+        // Watch another literal that is not false
+        const auto other =
+            std::find_if(clause.begin() + 2, clause.end(),
+                         [this](Literal literal) { return !IsFalse(literal); });
+        if (other != clause.end()) {
+          std::swap(clause[1], *other);
+          watches_[clause[1]].push_back(index);
+          continue;
+        }
+
+        watches[kept++] = index;
+        if (IsFalse(clause[0])) {
+          std::copy(watches.begin() + static_cast<std::ptrdiff_t>(i) + 1,
+                    watches.end(),
+                    watches.begin() + static_cast<std::ptrdiff_t>(kept));
+          watches.resize(kept + watches.size() - i - 1);
+          return false;
+        }
+        Assign(clause[0]);
+      }
+      watches.resize(kept);
+    }
+    return true;
+  }
+
+  std::vector<std::vector<Literal>> clauses_;
+  std::vector<int8_t> values_;
+  std::vector<std::vector<uint32_t>> watches_;
+  std::vector<Literal> trail_{};
+  std::vector<Decision> decisions_{};
+  // position in trail_ of the next literal to propagate
+  std::size_t head_{0};
+  // every variable before it is assigned
+  uint32_t next_{0};
+};
+} // namespace
+
+auto ModelFinder::FindModel(const Formula &formula, uint64_t max_size,
+                            TableauStats &stats) -> uint64_t {
+  for (uint64_t size = 1; size <= max_size; ++size) {
+    Cnf cnf;
+    if (!Grounder{size}.Ground(formula, cnf)) {
+      return 0;
+    }
+    stats.ground_clauses += cnf.clauses.size();
+
+    switch (Solver{std::move(cnf)}.Solve(kMaxConflicts)) {
+    case Solver::Result::kSatisfiable:
+      return size;
+    case Solver::Result::kUnsatisfiable:
+      break;
+    case Solver::Result::kUnknown:
+      return 0;
+    }
+  }
+
+  return 0;
+}
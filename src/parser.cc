@@ -1,16 +1,19 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <memory>
-#include <stack>
+#include <string>
+#include <string_view>
 
+#include "alloc_profiler.hh"
 #include "exprs/binary.hh"
 #include "exprs/expr.hh"
 #include "exprs/literal.hh"
 #include "exprs/unary.hh"
 #include "formula.hh"
 #include "parser.hh"
-#include "tokenizer.hh"
+#include "tracer.hh"
 
 namespace {
 // Basic Infos
@@ -40,37 +43,10 @@ const std::array kLiteralPredicate = {Token{"P"}, Token{"Q"}, Token{"R"},
                                       Token{"S"}};
 const std::array kVarPredicate = {Token{"x"}, Token{"y"}, Token{"z"},
                                   Token{"w"}};
+// Tokens after the predicate, e.g. "(x,y)"
+constexpr std::size_t kPredicateTokens{5};
 // Predicate Ends
 
-class ExprStack : std::stack<std::shared_ptr<Expr>> {
-public:
-  using std::stack<std::shared_ptr<Expr>>::empty;
-  using std::stack<std::shared_ptr<Expr>>::top;
-  using std::stack<std::shared_ptr<Expr>>::pop;
-  using std::stack<std::shared_ptr<Expr>>::emplace;
-
-  ExprStack() = default;
-  ~ExprStack() {
-    while (!empty()) {
-      [[maybe_unused]] Formula expr_destructor{std::move(top())};
-      pop();
-    }
-  }
-  ExprStack(const ExprStack &) = delete;
-  ExprStack(ExprStack &&) = delete;
-  auto operator=(const ExprStack &) -> ExprStack & = delete;
-  auto operator=(ExprStack &&) -> ExprStack & = delete;
-
-  [[nodiscard]] auto Error() const -> bool { return error_; }
-  auto SetError() -> void { error_ = true; }
-
-  auto Holder() -> std::shared_ptr<Expr> & { return holder_; }
-
-private:
-  std::shared_ptr<Expr> holder_{};
-  bool error_{false};
-};
-
 auto Merge(ExprStack &stack) -> void {
   auto expr = std::move(stack.top());
   stack.pop();
@@ -98,17 +74,13 @@ auto MergeStack(ExprStack &stack) -> void {
   }
 }
 
-auto ProcessLeftParenthesis(ExprStack &stack, Tokenizer &tokenizer,
-                            Token &token) -> void {
-  (void)tokenizer;
+auto ProcessLeftParenthesis(ExprStack &stack, Token &token) -> void {
   (void)token;
   // If ( => a new BinaryExpr
   stack.emplace(std::make_shared<BinaryExpr>());
 }
 
-auto ProcessRightParenthesis(ExprStack &stack, Tokenizer &tokenizer,
-                             Token &token) -> void {
-  (void)tokenizer;
+auto ProcessRightParenthesis(ExprStack &stack, Token &token) -> void {
   (void)token;
   // if these, we set an error
   //  - stack is empty
@@ -124,10 +96,7 @@ auto ProcessRightParenthesis(ExprStack &stack, Tokenizer &tokenizer,
   MergeStack(stack);
 }
 
-auto ProcessBinaryConnective(ExprStack &stack, Tokenizer &tokenizer,
-                             Token &token) -> void {
-  (void)tokenizer;
-
+auto ProcessBinaryConnective(ExprStack &stack, Token &token) -> void {
   // if these, we set an error
   //  - stack is empty (Binary Connective appears before any Formula)
   if (stack.empty()) {
@@ -148,9 +117,7 @@ auto ProcessBinaryConnective(ExprStack &stack, Tokenizer &tokenizer,
   stack.top()->Append(type);
 }
 
-auto ProcessUnaryProp(ExprStack &stack, Tokenizer &tokenizer, Token &token)
-    -> void {
-  (void)tokenizer;
+auto ProcessUnaryProp(ExprStack &stack, Token &token) -> void {
   // If UnaryProp (-) => create a new Unary Expr
   const ExprKind type =
       std::find_if(kUnaryPropToType.begin(), kUnaryPropToType.end(),
@@ -161,24 +128,15 @@ auto ProcessUnaryProp(ExprStack &stack, Tokenizer &tokenizer, Token &token)
   stack.emplace(std::make_shared<UnaryExpr>(type));
 }
 
-auto ProcessLiteralProp(ExprStack &stack, Tokenizer &tokenizer, Token &token)
-    -> void {
-  (void)tokenizer;
+auto ProcessLiteralProp(ExprStack &stack, Token &token) -> void {
   // If Literal => create a new literal
   stack.emplace(std::make_shared<Literal>(std::move(token)));
   MergeStack(stack);
 }
 
-auto ProcessUnaryPredicate(ExprStack &stack, Tokenizer &tokenizer, Token &token)
+// next_token is the token after the quantifier
+auto ProcessUnaryPredicate(ExprStack &stack, Token &token, Token next_token)
     -> void {
-  if (tokenizer.Empty()) {
-    stack.SetError();
-    return;
-  }
-
-  Token next_token = tokenizer.PeekToken();
-  tokenizer.PopToken();
-
   // If the bounded var cannot be founded in accepted var => set an error
   if (std::find(kVarPredicate.begin(), kVarPredicate.end(), next_token) ==
       kVarPredicate.end()) {
@@ -196,22 +154,11 @@ auto ProcessUnaryPredicate(ExprStack &stack, Tokenizer &tokenizer, Token &token)
 }
 
 // Process formulas like P(x,y)
-auto ProcessLiteralPredicate(ExprStack &stack, Tokenizer &tokenizer,
-                             Token &token) -> void {
-  (void)tokenizer;
-  std::array<Token, 5> token_holder;
-
+// token_holder is the 5 tokens after the predicate
+auto ProcessLiteralPredicate(ExprStack &stack, Token &token,
+                             std::array<Token, kPredicateTokens> token_holder)
+    -> void {
   // Hard coded way to process Predicate Formulas
-  for (std::array<Token, 5>::size_type i = 0; i < 5; ++i) {
-    if (tokenizer.Empty()) {
-      stack.SetError();
-      return;
-    }
-
-    token_holder[i] = tokenizer.PeekToken();
-    tokenizer.PopToken();
-  }
-
   if (!(token_holder[0] == Token{"("}) || !(token_holder[2] == Token{","}) ||
       !(token_holder[4] == Token{")"})) {
     stack.SetError();
@@ -234,78 +181,117 @@ auto ProcessLiteralPredicate(ExprStack &stack, Tokenizer &tokenizer,
 }
 } // namespace
 
-auto Parser::Parse(std::string line) -> ParserOutput {
-  bool proposition{false};
-  bool predicate{false};
-
-  Tokenizer tokenizer{line};
-  ExprStack stack;
-
-  /**
-   * Extract token until 1) no more token or 2) we get a formula that is a prop
-     and also pred
-   *
-   * Dispatch each token to its corresponding event
-   */
-  while (!tokenizer.Empty() && (!proposition || !predicate)) {
-    if (stack.Error() || (!stack.empty() && stack.top()->Error())) {
-      break;
-    }
-
-    // Get new Token
-    Token token = tokenizer.PeekToken();
-    tokenizer.PopToken();
+auto Parser::Stream::Feed(std::string_view chunk) -> void {
+  const AllocationScope allocation_scope{AllocationProfiler::Phase::kParse};
 
-    // Process new Token
-    if (std::find(kLeftParenthesisAll.begin(), kLeftParenthesisAll.end(),
-                  token) != kLeftParenthesisAll.end()) {
-      ProcessLeftParenthesis(stack, tokenizer, token);
-      continue;
-    }
+  if (keep_raw_) {
+    raw_formula_ += chunk;
+  }
 
-    if (std::find(kRightParenthesisAll.begin(), kRightParenthesisAll.end(),
-                  token) != kRightParenthesisAll.end()) {
-      ProcessRightParenthesis(stack, tokenizer, token);
-      continue;
+  constexpr std::string_view kWhitespaces{" \t\n\v\f\r"};
+  for (const char c : chunk) {
+    if (kWhitespaces.find(c) == std::string_view::npos) {
+      Consume(c);
     }
+  }
+}
 
-    if (std::find(kBinaryAll.begin(), kBinaryAll.end(), token) !=
-        kBinaryAll.end()) {
-      ProcessBinaryConnective(stack, tokenizer, token);
-      continue;
-    }
+/*
+  Dispatch each token to its corresponding event, until we get a formula
+  that is a prop and also pred (or an error)
 
-    if (std::find(kUnaryProp.begin(), kUnaryProp.end(), token) !=
-        kUnaryProp.end()) {
-      ProcessUnaryProp(stack, tokenizer, token);
-      continue;
-    }
+  The tokens of a quantifier and of a predicate literal are gathered in
+  pending_ first, as they may be split across chunks.
+*/
+auto Parser::Stream::Consume(char c) -> void {
+  if ((proposition_ && predicate_) || stack_.Error() ||
+      (!stack_.empty() && stack_.top()->Error())) {
+    return;
+  }
 
-    if (std::find(kLiteralProp.begin(), kLiteralProp.end(), token) !=
-        kLiteralProp.end()) {
-      ProcessLiteralProp(stack, tokenizer, token);
-      proposition = true;
-      continue;
-    }
+  if (!pending_.empty()) {
+    pending_ += c;
+    Token token{pending_.substr(0, 1)};
 
-    /* quantifier here */
+    // quantifier => one more token (the variable)
     if (std::find(kUnaryPredicate.begin(), kUnaryPredicate.end(), token) !=
         kUnaryPredicate.end()) {
-      ProcessUnaryPredicate(stack, tokenizer, token);
-      predicate = true;
-      continue;
+      ProcessUnaryPredicate(stack_, token, Token{pending_.substr(1)});
+      pending_.clear();
+      return;
     }
 
-    // literal in predicate logic
-    if (std::find(kLiteralPredicate.begin(), kLiteralPredicate.end(), token) !=
-        kLiteralPredicate.end()) {
-      ProcessLiteralPredicate(stack, tokenizer, token);
-      predicate = true;
-      continue;
+    // predicate => kPredicateTokens more tokens
+    if (pending_.size() == kPredicateTokens + 1) {
+      std::array<Token, kPredicateTokens> token_holder;
+      for (std::size_t i = 0; i < kPredicateTokens; ++i) {
+        token_holder[i] = Token{pending_.substr(i + 1, 1)};
+      }
+      ProcessLiteralPredicate(stack_, token, std::move(token_holder));
+      pending_.clear();
     }
+    return;
+  }
 
-    // no match
-    stack.SetError();
+  // Get new Token
+  Token token{std::string(1, c)};
+
+  // Process new Token
+  if (std::find(kLeftParenthesisAll.begin(), kLeftParenthesisAll.end(),
+                token) != kLeftParenthesisAll.end()) {
+    ProcessLeftParenthesis(stack_, token);
+    return;
+  }
+
+  if (std::find(kRightParenthesisAll.begin(), kRightParenthesisAll.end(),
+                token) != kRightParenthesisAll.end()) {
+    ProcessRightParenthesis(stack_, token);
+    return;
+  }
+
+  if (std::find(kBinaryAll.begin(), kBinaryAll.end(), token) !=
+      kBinaryAll.end()) {
+    ProcessBinaryConnective(stack_, token);
+    return;
+  }
+
+  if (std::find(kUnaryProp.begin(), kUnaryProp.end(), token) !=
+      kUnaryProp.end()) {
+    ProcessUnaryProp(stack_, token);
+    return;
+  }
+
+  if (std::find(kLiteralProp.begin(), kLiteralProp.end(), token) !=
+      kLiteralProp.end()) {
+    ProcessLiteralProp(stack_, token);
+    proposition_ = true;
+    return;
+  }
+
+  /* quantifier and literal in predicate logic here */
+  if (std::find(kUnaryPredicate.begin(), kUnaryPredicate.end(), token) !=
+          kUnaryPredicate.end() ||
+      std::find(kLiteralPredicate.begin(), kLiteralPredicate.end(), token) !=
+          kLiteralPredicate.end()) {
+    pending_ = token.ToString();
+    predicate_ = true;
+    return;
+  }
+
+  // no match
+  stack_.SetError();
+}
+
+auto Parser::Stream::Finish() -> ParserOutput {
+  return Finish(std::move(raw_formula_));
+}
+
+auto Parser::Stream::Finish(std::string raw_formula) -> ParserOutput {
+  const AllocationScope allocation_scope{AllocationProfiler::Phase::kParse};
+
+  // the last quantifier or predicate misses some tokens
+  if (!pending_.empty()) {
+    stack_.SetError();
   }
 
   /*
@@ -316,12 +302,23 @@ auto Parser::Parse(std::string line) -> ParserOutput {
       - top formula is not complete (missing symbol - incorrect syntax)
       - top formula is in error (unmatched symbol - incorrect syntax)
   */
-  auto &expr = stack.Holder();
-  if (stack.Error() || !stack.empty() || (proposition == predicate) || !expr) {
-    return ParserOutput{{}, std::move(line), ParseResult::kNotAFormula};
+  auto &expr = stack_.Holder();
+  if (stack_.Error() || !stack_.empty() || (proposition_ == predicate_) ||
+      !expr) {
+    return ParserOutput{{}, std::move(raw_formula), ParseResult::kNotAFormula};
   }
 
-  return ParserOutput{Formula{std::move(expr)}, std::move(line),
-                      proposition ? ParseResult::kProposition
-                                  : ParseResult::kPredicate};
+  return ParserOutput{Formula{std::move(expr)}, std::move(raw_formula),
+                      proposition_ ? ParseResult::kProposition
+                                   : ParseResult::kPredicate};
+}
+
+auto Parser::Parse(std::string line) -> ParserOutput {
+  const TraceSpan span{"Parser::Parse"};
+  const AllocationScope allocation_scope{AllocationProfiler::Phase::kParse};
+
+  // The line is kept as the raw formula, so the stream does not copy it
+  Stream stream;
+  stream.Feed(line);
+  return stream.Finish(std::move(line));
 }
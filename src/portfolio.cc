@@ -0,0 +1,113 @@
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "portfolio.hh"
+
+namespace {
+struct Strategy {
+  const char *name;
+  TableauOptions options;
+};
+
+auto SameStrategy(const TableauOptions &lhs, const TableauOptions &rhs)
+    -> bool {
+  return lhs.depth_first == rhs.depth_first &&
+         lhs.semantic_branching == rhs.semantic_branching &&
+         lhs.propagation == rhs.propagation &&
+         lhs.batch_gamma == rhs.batch_gamma &&
+         lhs.reuse_constants == rhs.reuse_constants;
+}
+
+auto MakeStrategies(const Parser::ParserOutput &parser_out,
+                    const TableauOptions &options,
+                    const std::atomic<bool> &cancel) -> std::vector<Strategy> {
+  TableauOptions base = options;
+  base.portfolio = false;
+  base.cancel = &cancel;
+
+  std::vector<Strategy> strategies{{"base", base}};
+  const auto add = [&strategies](const char *name,
+                                 const TableauOptions &strategy_options) {
+    for (const auto &strategy : strategies) {
+      if (SameStrategy(strategy.options, strategy_options)) {
+        return;
+      }
+    }
+    strategies.push_back({name, strategy_options});
+  };
+
+  auto depth_first = base;
+  depth_first.depth_first = true;
+  add("depth-first", depth_first);
+
+  auto semantic = base;
+  semantic.semantic_branching = true;
+  semantic.propagation = true;
+  add("semantic", semantic);
+
+  // Only quantified formulas have constants to batch or reuse
+  if (parser_out.Result() == Parser::ParseResult::kPredicate) {
+    auto constants = base;
+    constants.batch_gamma = true;
+    constants.reuse_constants = true;
+    add("constants", constants);
+  }
+  return strategies;
+}
+
+auto Definite(const Tableau::TableauOutput &output) -> bool {
+  return output.Result() != Tableau::TableauResult::kUndecidable;
+}
+} // namespace
+
+auto Portfolio::Solve(const Parser::ParserOutput &parser_out,
+                      const TableauOptions &options)
+    -> Tableau::TableauOutput {
+  std::atomic<bool> cancel{false};
+  const auto strategies = MakeStrategies(parser_out, options, cancel);
+
+  std::vector<std::optional<Tableau::TableauOutput>> outputs(
+      strategies.size());
+  std::vector<std::exception_ptr> errors(strategies.size());
+  std::mutex mutex;
+  std::optional<std::size_t> winner;
+
+  const auto run = [&](std::size_t i) {
+    try {
+      auto output = Tableau::Solve(parser_out, strategies[i].options);
+      if (Definite(output)) {
+        const std::lock_guard lock{mutex};
+        if (!winner.has_value()) {
+          winner = i;
+          cancel.store(true, std::memory_order_relaxed);
+        }
+      }
+      outputs[i] = std::move(output);
+    } catch (...) {
+      errors[i] = std::current_exception();
+    }
+  };
+
+  // The calling thread runs the first strategy itself
+  std::vector<std::thread> threads;
+  threads.reserve(strategies.size() - 1);
+  for (std::size_t i = 1; i < strategies.size(); ++i) {
+    threads.emplace_back(run, i);
+  }
+  run(0);
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  const auto index = winner.value_or(0);
+  if (!outputs[index].has_value()) {
+    std::rethrow_exception(errors[index]);
+  }
+  auto stats = outputs[index]->Stats();
+  stats.strategy = strategies[index].name;
+  return Tableau::TableauOutput{outputs[index]->Result(), stats};
+}
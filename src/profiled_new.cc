@@ -0,0 +1,98 @@
+#include <cstddef>
+#include <new>
+
+#include "alloc_profiler.hh"
+
+// Route the allocations of the executables (main.out, bench.out, ...)
+// through the allocation profiler, which only counts them once enabled
+// (every form: plain, sized, over-aligned and nothrow)
+// This object is linked into every executable but kept out of libtableau,
+// whose users keep their own operator new
+auto operator new(std::size_t size) -> void * { return ProfiledAllocate(size); }
+auto operator new[](std::size_t size) -> void * {
+  return ProfiledAllocate(size);
+}
+auto operator delete(void *pointer) noexcept -> void { ProfiledFree(pointer); }
+auto operator delete[](void *pointer) noexcept -> void {
+  ProfiledFree(pointer);
+}
+auto operator delete(void *pointer, std::size_t /*size*/) noexcept -> void {
+  ProfiledFree(pointer);
+}
+auto operator delete[](void *pointer, std::size_t /*size*/) noexcept -> void {
+  ProfiledFree(pointer);
+}
+
+// Over-aligned types
+auto operator new(std::size_t size, std::align_val_t alignment) -> void * {
+  return ProfiledAllocate(size, static_cast<std::size_t>(alignment));
+}
+auto operator new[](std::size_t size, std::align_val_t alignment) -> void * {
+  return ProfiledAllocate(size, static_cast<std::size_t>(alignment));
+}
+auto operator delete(void *pointer, std::align_val_t /*alignment*/) noexcept
+    -> void {
+  ProfiledFree(pointer);
+}
+auto operator delete[](void *pointer, std::align_val_t /*alignment*/) noexcept
+    -> void {
+  ProfiledFree(pointer);
+}
+auto operator delete(void *pointer, std::size_t /*size*/,
+                     std::align_val_t /*alignment*/) noexcept -> void {
+  ProfiledFree(pointer);
+}
+auto operator delete[](void *pointer, std::size_t /*size*/,
+                       std::align_val_t /*alignment*/) noexcept -> void {
+  ProfiledFree(pointer);
+}
+
+// new (std::nothrow), which returns nullptr instead of throwing bad_alloc
+auto operator new(std::size_t size, const std::nothrow_t & /*tag*/) noexcept
+    -> void * {
+  try {
+    return ProfiledAllocate(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+auto operator new[](std::size_t size, const std::nothrow_t & /*tag*/) noexcept
+    -> void * {
+  try {
+    return ProfiledAllocate(size);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+auto operator new(std::size_t size, std::align_val_t alignment,
+                  const std::nothrow_t & /*tag*/) noexcept -> void * {
+  try {
+    return ProfiledAllocate(size, static_cast<std::size_t>(alignment));
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+auto operator new[](std::size_t size, std::align_val_t alignment,
+                    const std::nothrow_t & /*tag*/) noexcept -> void * {
+  try {
+    return ProfiledAllocate(size, static_cast<std::size_t>(alignment));
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+auto operator delete(void *pointer, const std::nothrow_t & /*tag*/) noexcept
+    -> void {
+  ProfiledFree(pointer);
+}
+auto operator delete[](void *pointer, const std::nothrow_t & /*tag*/) noexcept
+    -> void {
+  ProfiledFree(pointer);
+}
+auto operator delete(void *pointer, std::align_val_t /*alignment*/,
+                     const std::nothrow_t & /*tag*/) noexcept -> void {
+  ProfiledFree(pointer);
+}
+auto operator delete[](void *pointer, std::align_val_t /*alignment*/,
+                       const std::nothrow_t & /*tag*/) noexcept -> void {
+  ProfiledFree(pointer);
+}
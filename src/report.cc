@@ -0,0 +1,208 @@
+#include <cassert>
+#include <optional>
+#include <vector>
+
+#include "report.hh"
+
+namespace {
+auto PrintRuleStatistics(Writer &out, const char *name,
+                         const TableauStats::RuleStats &rule) -> void {
+  out << ",\"" << name << "\":{\"count\":" << rule.count
+      << ",\"ns\":" << rule.nanoseconds << "}";
+}
+} // namespace
+
+auto PrintAllocationStatistics(
+    Writer &out, const char *key, uint64_t value,
+    const AllocationProfiler::PhaseCounters &counters) -> void {
+  out << "{\"" << key << "\":" << value;
+  for (std::size_t i = 0; i < counters.size(); ++i) {
+    const auto &phase = counters[i];
+    out << ",\""
+        << AllocationProfiler::PhaseName(
+               static_cast<AllocationProfiler::Phase>(i))
+        << "\":{\"allocations\":" << phase.allocations
+        << ",\"bytes\":" << phase.bytes << ",\"frees\":" << phase.frees
+        << ",\"peak_bytes\":" << phase.peak_bytes << "}";
+  }
+  out << "}\n";
+}
+
+auto operator<<(Writer &out, const Formula &formula) -> Writer & {
+  formula.AppendDescription(out.Buffer());
+  return out;
+}
+
+auto PrintParserInformation(Writer &out,
+                            const Parser::ParserOutput &parser_out) -> void {
+  const Parser::ParseResult result = parser_out.Result();
+  const Formula &formula = parser_out.GetFormula();
+
+  if (result == Parser::ParseResult::kNotAFormula) {
+    out << parser_out.RawFormula() << " is not a formula.\n";
+    return;
+  }
+
+  const auto type = formula.Type();
+
+  if (result == Parser::ParseResult::kProposition) {
+    if (ExprKind::IsLiteral(type)) {
+      out << formula << " is a proposition.\n";
+      return;
+    }
+    if (ExprKind::IsUnary(type)) {
+      out << formula << " is a negation of a propositional formula.\n";
+      return;
+    }
+    if (ExprKind::IsBinary(type)) {
+      out << formula << " is a binary connective propositional formula. ";
+      std::vector children = formula.ViewChildren();
+      assert(children.size() == 2);
+      out << "Its left hand side is " << children[0];
+      out << ", its connective is " << formula.Connective();
+      out << ", and its right hand side is " << children[1];
+      out << ".\n";
+      return;
+    }
+  }
+
+  if (result == Parser::ParseResult::kPredicate) {
+    if (ExprKind::IsLiteral(type)) {
+      out << formula << " is an atom.\n";
+      return;
+    }
+    if (type == ExprKind::kNeg) {
+      out << formula << " is a negation of a first order logic formula.\n";
+      return;
+    }
+    if (type == ExprKind::kUniversal) {
+      out << formula << " is a universally quantified formula.\n";
+      return;
+    }
+    if (type == ExprKind::kExist) {
+      out << formula << " is an existentially quantified formula.\n";
+      return;
+    }
+    if (ExprKind::IsBinary(type)) {
+      out << formula << " is a binary connective first order formula. ";
+      std::vector children = formula.ViewChildren();
+      assert(children.size() == 2);
+      out << "Its left hand side is " << children[0];
+      out << ", its connective is " << formula.Connective();
+      out << ", and its right hand side is " << children[1];
+      out << ".\n";
+      return;
+    }
+  }
+}
+
+auto PrintTableauInformation(Writer &out,
+                             const Parser::ParserOutput &parser_out,
+                             const Tableau::TableauResult &tableau_out)
+    -> void {
+  const Formula &formula = parser_out.GetFormula();
+  switch (tableau_out) {
+  case Tableau::TableauResult::kUnsatisfiable:
+    out << formula << " is not satisfiable.\n";
+    break;
+  case Tableau::TableauResult::kSatisfiable:
+    out << formula << " is satisfiable.\n";
+    break;
+  case Tableau::TableauResult::kUndecidable:
+    out << formula << " may or may not be satisfiable.\n";
+    break;
+  }
+}
+
+auto ResultName(Tableau::TableauResult result) -> const char * {
+  switch (result) {
+  case Tableau::TableauResult::kUnsatisfiable:
+    return "unsatisfiable";
+  case Tableau::TableauResult::kSatisfiable:
+    return "satisfiable";
+  case Tableau::TableauResult::kUndecidable:
+    return "undecidable";
+  }
+  return "";
+}
+
+auto PrintStatistics(Writer &out, uint64_t line_number,
+                     const std::optional<Tableau::TableauOutput> &tableau_out,
+                     uint64_t nanoseconds) -> void {
+  out << "{\"line\":" << line_number;
+  if (!tableau_out.has_value()) {
+    out << ",\"result\":null}\n";
+    return;
+  }
+
+  out << ",\"result\":\"" << ResultName(tableau_out->Result())
+      << "\",\"ns\":" << nanoseconds;
+
+  const auto &stats = tableau_out->Stats();
+  PrintRuleStatistics(out, "alpha", stats.alpha);
+  PrintRuleStatistics(out, "beta", stats.beta);
+  PrintRuleStatistics(out, "gamma", stats.gamma);
+  PrintRuleStatistics(out, "delta", stats.delta);
+  PrintRuleStatistics(out, "negation", stats.negation);
+  out << ",\"branches_created\":" << stats.branches_created
+      << ",\"branches_closed\":" << stats.branches_closed
+      << ",\"theory_copies\":" << stats.theory_copies
+      << ",\"nodes_copied\":" << stats.nodes_copied
+      << ",\"constants_introduced\":" << stats.constants_introduced
+      << ",\"constants_reused\":" << stats.constants_reused
+      << ",\"peak_frontier\":" << stats.peak_frontier
+      << ",\"propagations\":" << stats.propagations
+      << ",\"ground_clauses\":" << stats.ground_clauses
+      << ",\"model_size\":" << stats.model_size
+      << ",\"cache_hits\":" << stats.cache_hits;
+  if (stats.strategy != nullptr) {
+    out << ",\"strategy\":\"" << stats.strategy << "\"";
+  }
+  out << "}\n";
+}
+
+auto KindName(const Parser::ParserOutput &parser_out) -> const char * {
+  const auto result = parser_out.Result();
+  if (result == Parser::ParseResult::kNotAFormula) {
+    return "not-a-formula";
+  }
+
+  const auto type = parser_out.GetFormula().Type();
+  const bool proposition = result == Parser::ParseResult::kProposition;
+  if (ExprKind::IsLiteral(type)) {
+    return proposition ? "proposition" : "atom";
+  }
+  if (ExprKind::IsBinary(type)) {
+    return proposition ? "propositional-binary" : "binary";
+  }
+  if (type == ExprKind::kUniversal) {
+    return "universal";
+  }
+  if (type == ExprKind::kExist) {
+    return "existential";
+  }
+  return proposition ? "propositional-negation" : "negation";
+}
+
+auto PrintRecord(Writer &out, uint64_t line_number,
+                 const Parser::ParserOutput &parser_out, bool parse,
+                 const std::optional<Tableau::TableauOutput> &tableau_out)
+    -> void {
+  out << line_number << '\t';
+  if (parser_out.Result() == Parser::ParseResult::kNotAFormula) {
+    out << parser_out.RawFormula();
+  } else {
+    out << parser_out.GetFormula();
+  }
+
+  out << '\t';
+  if (parse) {
+    out << KindName(parser_out);
+  }
+
+  out << '\t';
+  if (tableau_out.has_value()) {
+    out << ResultName(tableau_out->Result());
+  }
+  out << '\n';
+}
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "constant.hh"
+#include "result_cache.hh"
+#include "utils/serialize.hh"
+
+namespace {
+constexpr uint64_t kMagic{0x4548434143424154ULL}; // "TABCACHE"
+// Bump it when the serialization of formulas or the meaning of an option
+// changes, so that old files are rejected
+constexpr uint64_t kVersion{1};
+
+constexpr std::size_t kHeaderSize{2 * sizeof(uint64_t)};
+constexpr std::size_t kRecordSize{3 * sizeof(uint64_t)};
+
+constexpr uint64_t kFnvPrime{0x100000001b3ULL};
+
+// FNV-1a, then a final mix so that all the bits depend on the last bytes
+template <typename It>
+auto HashBytes(It begin, It end, uint64_t basis) -> uint64_t {
+  uint64_t hash{basis};
+  for (; begin != end; ++begin) {
+    hash ^= static_cast<unsigned char>(*begin);
+    hash *= kFnvPrime;
+  }
+
+  hash ^= hash >> 30U;
+  hash *= 0xbf58476d1ce4e5b9ULL;
+  hash ^= hash >> 27U;
+  hash *= 0x94d049bb133111ebULL;
+  return hash ^ (hash >> 31U);
+}
+
+auto WriteHeader(std::string &out) -> void {
+  WriteInteger(out, kMagic);
+  WriteInteger(out, kVersion);
+}
+
+auto WriteRecord(std::string &out, const ResultCache::Key &key,
+                 Tableau::TableauResult result) -> void {
+  WriteInteger(out, key.high);
+  WriteInteger(out, key.low);
+  WriteInteger(out, static_cast<uint64_t>(result));
+}
+
+auto WriteAll(int fd, std::string_view bytes) -> bool {
+  while (!bytes.empty()) {
+    const auto written = ::write(fd, bytes.data(), bytes.size());
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    bytes.remove_prefix(static_cast<std::size_t>(written));
+  }
+  return true;
+}
+} // namespace
+
+auto ResultCache::MakeKey(const Formula &formula,
+                          const TableauOptions &options) -> Key {
+  std::string bytes;
+  formula.Serialize(bytes);
+  WriteInteger(bytes, ConstantManager::Limit());
+  WriteInteger(bytes, options.semantic_branching ? 1 : 0);
+  WriteInteger(bytes, options.propagation ? 1 : 0);
+  WriteInteger(bytes, options.free_variable_depth);
+  WriteInteger(bytes, options.model_finding_size);
+  WriteInteger(bytes, options.batch_gamma ? 1 : 0);
+  WriteInteger(bytes, options.reuse_constants ? 1 : 0);
+  // A strategy of the portfolio may decide what the options alone do not
+  // (depth_first does not change the result)
+  WriteInteger(bytes, options.portfolio ? 1 : 0);
+
+  return Key{HashBytes(bytes.begin(), bytes.end(), 0xcbf29ce484222325ULL),
+             HashBytes(bytes.rbegin(), bytes.rend(), 0x84222325cbf29ce4ULL)};
+}
+
+ResultCache::~ResultCache() { Flush(); }
+
+auto ResultCache::Load() -> bool {
+  const int fd = ::open(path_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return errno == ENOENT;
+  }
+
+  struct stat status {};
+  if (::fstat(fd, &status) != 0) {
+    ::close(fd);
+    return false;
+  }
+  const auto size = static_cast<std::size_t>(status.st_size);
+  if (size == 0) {
+    ::close(fd);
+    return true;
+  }
+  if (size < kHeaderSize) {
+    ::close(fd);
+    return false;
+  }
+
+  void *data = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close(fd);
+  if (data == MAP_FAILED) {
+    return false;
+  }
+
+  std::string_view in{static_cast<const char *>(data), size};
+  bool good = ReadInteger(in) == kMagic && ReadInteger(in) == kVersion;
+
+  const std::lock_guard lock{mutex_};
+  records_ = in.size() / kRecordSize;
+  torn_ = in.size() % kRecordSize != 0;
+  entries_.reserve(records_);
+  for (uint64_t i = 0; good && i < records_; ++i) {
+    Key key{};
+    key.high = ReadInteger(in);
+    key.low = ReadInteger(in);
+    const auto result = ReadInteger(in);
+    good = result <=
+           static_cast<uint64_t>(Tableau::TableauResult::kUndecidable);
+    entries_[key] = static_cast<Tableau::TableauResult>(result);
+  }
+
+  ::munmap(data, size);
+  if (!good) {
+    entries_.clear();
+    records_ = 0;
+  }
+  return good;
+}
+
+auto ResultCache::Find(const Key &key) const
+    -> std::optional<Tableau::TableauResult> {
+  const std::lock_guard lock{mutex_};
+  const auto it = entries_.find(key);
+  if (it == entries_.end()) {
+    return std::nullopt;
+  }
+  return it->second;
+}
+
+auto ResultCache::Insert(const Key &key, Tableau::TableauResult result)
+    -> void {
+  const std::lock_guard lock{mutex_};
+  entries_[key] = result;
+  pending_[key] = result;
+}
+
+auto ResultCache::Flush() -> bool {
+  const std::lock_guard lock{mutex_};
+  if (pending_.empty() && !torn_) {
+    return true;
+  }
+
+  // Appending to a torn file would shift all the following records
+  if (torn_ || records_ + pending_.size() >
+                   std::max(kMinCompactRecords, 2 * entries_.size())) {
+    return Compact();
+  }
+
+  const int fd = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  std::string out;
+  struct stat status {};
+  if (::fstat(fd, &status) == 0 && status.st_size == 0) {
+    WriteHeader(out);
+  }
+  for (const auto &[key, result] : pending_) {
+    WriteRecord(out, key, result);
+  }
+
+  const bool good = WriteAll(fd, out);
+  ::close(fd);
+  if (good) {
+    records_ += pending_.size();
+    pending_.clear();
+  }
+  return good;
+}
+
+auto ResultCache::Compact() -> bool {
+  const auto temporary = path_ + ".tmp";
+  const int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+
+  std::string out;
+  WriteHeader(out);
+  for (const auto &[key, result] : entries_) {
+    WriteRecord(out, key, result);
+  }
+
+  bool good = WriteAll(fd, out);
+  good = ::close(fd) == 0 && good;
+  if (!good || std::rename(temporary.c_str(), path_.c_str()) != 0) {
+    ::unlink(temporary.c_str());
+    return false;
+  }
+
+  records_ = entries_.size();
+  pending_.clear();
+  torn_ = false;
+  return true;
+}
@@ -0,0 +1,351 @@
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <csignal>
+#include <cstring>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "batch.hh"
+#include "parser.hh"
+#include "report.hh"
+#include "server.hh"
+#include "writer.hh"
+
+namespace {
+constexpr std::size_t kReadSize{1U << 16U};
+
+// Commands on the incremental solver of the connection
+enum class Incremental { kNone, kPush, kPop, kAssert, kCheck };
+
+struct Request {
+  uint64_t id{0};
+  bool parse{false};
+  bool solve{false};
+  Incremental incremental{Incremental::kNone};
+  std::string formula{};
+};
+
+// Split "id\tcommands\tformula", nullopt if the request is malformed
+auto ParseRequest(std::string_view line) -> std::optional<Request> {
+  const auto first = line.find('\t');
+  const auto second =
+      first == std::string_view::npos ? first : line.find('\t', first + 1);
+  if (second == std::string_view::npos) {
+    return std::nullopt;
+  }
+
+  Request request;
+  const auto id = line.substr(0, first);
+  const auto [end, error] =
+      std::from_chars(id.data(), id.data() + id.size(), request.id);
+  if (id.empty() || error != std::errc{} || end != id.data() + id.size()) {
+    return std::nullopt;
+  }
+
+  auto commands = line.substr(first + 1, second - first - 1);
+  uint64_t incremental_commands{0};
+  while (!commands.empty()) {
+    const auto word = commands.substr(0, commands.find(' '));
+    if (word == "PARSE") {
+      request.parse = true;
+    } else if (word == "SAT") {
+      request.solve = true;
+    } else if (word == "PUSH" || word == "POP" || word == "ASSERT" ||
+               word == "CHECK") {
+      request.incremental = word == "PUSH"     ? Incremental::kPush
+                            : word == "POP"    ? Incremental::kPop
+                            : word == "ASSERT" ? Incremental::kAssert
+                                               : Incremental::kCheck;
+      ++incremental_commands;
+    } else if (!word.empty()) {
+      return std::nullopt;
+    }
+    commands.remove_prefix(std::min(commands.size(), word.size() + 1));
+  }
+  // an incremental command comes alone
+  if (incremental_commands > 1 ||
+      (incremental_commands == 1 && (request.parse || request.solve))) {
+    return std::nullopt;
+  }
+
+  request.formula = line.substr(second + 1);
+  return request;
+}
+// Response to a request on the incremental solver of the connection, whose
+// fields are the ones of the other responses: id, formula (of ASSERT), an
+// empty kind and the result (of CHECK)
+auto AnswerIncremental(const Request &request, const std::string &line,
+                       IncrementalTableau &tableau) -> std::string {
+  Writer out;
+  const auto error = [&out, &line] {
+    out << "error\t" << line << '\n';
+    return out.Take();
+  };
+
+  std::optional<Tableau::TableauResult> result;
+  switch (request.incremental) {
+  case Incremental::kPush:
+    tableau.Push();
+    break;
+  case Incremental::kPop:
+    if (tableau.Depth() == 0) {
+      return error();
+    }
+    tableau.Pop();
+    break;
+  case Incremental::kAssert: {
+    const auto parse_out = Parser::Parse(request.formula);
+    if (parse_out.Result() == Parser::ParseResult::kNotAFormula) {
+      return error();
+    }
+    tableau.Assert(parse_out.GetFormula());
+    break;
+  }
+  case Incremental::kCheck:
+    result = tableau.Check();
+    break;
+  case Incremental::kNone:
+    break;
+  }
+
+  out << request.id << '\t';
+  if (request.incremental == Incremental::kAssert) {
+    out << request.formula;
+  }
+  out << "\t\t";
+  if (result.has_value()) {
+    out << ResultName(*result);
+  }
+  out << '\n';
+  return out.Take();
+}
+} // namespace
+
+Server::~Server() {
+  std::unique_lock lock{connections_mutex_};
+  connections_cv_.wait(lock, [this] { return connections_ == 0; });
+}
+
+auto Server::Answer(const std::string &line) -> std::string {
+  Writer out;
+
+  const auto request = ParseRequest(line);
+  if (!request.has_value()) {
+    out << "error\t" << line << '\n';
+    return out.Take();
+  }
+
+  const auto parse_out = Parser::Parse(request->formula);
+
+  std::optional<Tableau::TableauOutput> tableau_out;
+  if (request->solve &&
+      parse_out.Result() != Parser::ParseResult::kNotAFormula) {
+    std::unique_lock lock{cache_mutex_};
+    const auto it = cache_.find(request->formula);
+    if (it != cache_.end()) {
+      tableau_out.emplace(it->second, TableauStats{});
+    } else {
+      lock.unlock();
+      tableau_out = Tableau::Solve(parse_out, options_);
+      lock.lock();
+
+      const auto [inserted, is_new] =
+          cache_.emplace(request->formula, tableau_out->Result());
+      // another request may have solved the formula in the meantime
+      if (is_new) {
+        cache_order_.push_back(&inserted->first);
+        if (cache_order_.size() > kMaxCachedResults) {
+          cache_.erase(cache_.find(*cache_order_.front()));
+          cache_order_.pop_front();
+        }
+      }
+    }
+  }
+
+  PrintRecord(out, request->id, parse_out, request->parse, tableau_out);
+  return out.Take();
+}
+
+auto Server::Serve(int in_fd, int out_fd) -> bool {
+  Writer out{out_fd};
+  Writer err;
+  std::optional<BatchRunner> runner;
+  if (jobs_ != 1) {
+    runner.emplace(jobs_, out, err);
+  }
+
+  // created by the first incremental command of the connection
+  std::optional<IncrementalTableau> incremental;
+
+  const auto submit = [this, &out, &runner,
+                       &incremental](std::string request) {
+    if (!request.empty() && request.back() == '\r') {
+      request.pop_back();
+    }
+
+    // The commands on the incremental solver depend on the ones before:
+    // they are answered in order, on this thread
+    if (const auto parsed = ParseRequest(request);
+        parsed.has_value() && parsed->incremental != Incremental::kNone) {
+      if (runner.has_value()) {
+        runner->Drain();
+      }
+      if (!incremental.has_value()) {
+        incremental.emplace(options_);
+      }
+      out << AnswerIncremental(*parsed, request, *incremental);
+      out.EndRecord();
+      return;
+    }
+
+    if (runner.has_value()) {
+      runner->Submit([this, request = std::move(request)] {
+        return BatchRunner::Output{Answer(request), {}};
+      });
+    } else {
+      out << Answer(request);
+      out.EndRecord();
+    }
+  };
+
+  const auto reject = [&out, &runner] {
+    if (runner.has_value()) {
+      runner->Submit([] { return BatchRunner::Output{"error\n", {}}; });
+    } else {
+      out << "error\n";
+      out.EndRecord();
+    }
+  };
+
+  // Bytes read, the requests before start are already submitted
+  std::string pending;
+  std::size_t start{0};
+  std::string buffer(kReadSize, '\0');
+  bool good{true};
+  // the rest of a request that is too long is dropped up to its '\n'
+  bool dropping{false};
+
+  while (good) {
+    const auto newline = pending.find('\n', start);
+    if (newline != std::string::npos) {
+      if (!dropping) {
+        submit(pending.substr(start, newline - start));
+      }
+      dropping = false;
+      start = newline + 1;
+      continue;
+    }
+    pending.erase(0, start);
+    start = 0;
+
+    // A client that never sends '\n' must not grow pending without bound
+    if (pending.size() > kMaxRequestSize) {
+      if (!dropping) {
+        reject();
+      }
+      dropping = true;
+      pending.clear();
+    }
+
+    // The next read may block: answer the requests received so far
+    if (runner.has_value()) {
+      runner->Drain();
+    }
+    good = out.Flush();
+
+    const auto size = ::read(in_fd, buffer.data(), buffer.size());
+    if (size == 0) {
+      break;
+    }
+    if (size < 0) {
+      good = errno == EINTR;
+      continue;
+    }
+    pending.append(buffer.data(), static_cast<std::size_t>(size));
+  }
+
+  // The last request may lack its '\n'
+  if (good && !pending.empty() && !dropping) {
+    submit(std::move(pending));
+  }
+  if (runner.has_value()) {
+    runner->Finish();
+  }
+  return out.Flush() && good;
+}
+
+auto Server::Listen(const std::string &path) -> bool {
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    return false;
+  }
+  std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+  // A client that disconnects early must not kill the server
+  std::signal(SIGPIPE, SIG_IGN);
+
+  const int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (listener < 0) {
+    return false;
+  }
+
+  // Only replace a socket: path may be a regular file given by mistake
+  struct stat status {};
+  if (::lstat(path.c_str(), &status) == 0) {
+    if (!S_ISSOCK(status.st_mode) || ::unlink(path.c_str()) != 0) {
+      ::close(listener);
+      return false;
+    }
+  } else if (errno != ENOENT) {
+    ::close(listener);
+    return false;
+  }
+
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  if (::bind(listener, reinterpret_cast<const sockaddr *>(&address),
+             sizeof(address)) != 0 ||
+      ::listen(listener, SOMAXCONN) != 0) {
+    ::close(listener);
+    return false;
+  }
+
+  while (true) {
+    // Only this thread adds connections, so there is room after the wait
+    {
+      std::unique_lock lock{connections_mutex_};
+      connections_cv_.wait(
+          lock, [this] { return connections_ < kMaxConnections; });
+    }
+
+    const int connection = ::accept(listener, nullptr, nullptr);
+    if (connection < 0) {
+      if (errno == EINTR || errno == ECONNABORTED) {
+        continue;
+      }
+      ::close(listener);
+      return false;
+    }
+
+    {
+      const std::lock_guard lock{connections_mutex_};
+      ++connections_;
+    }
+    std::thread{[this, connection] {
+      (void)Serve(connection, connection);
+      ::close(connection);
+
+      const std::lock_guard lock{connections_mutex_};
+      --connections_;
+      connections_cv_.notify_all();
+    }}.detach();
+  }
+}
@@ -1,16 +1,28 @@
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <queue>
 #include <utility>
 #include <vector>
 
+#include "alloc_profiler.hh"
 #include "exprs/binary.hh"
 #include "exprs/literal.hh"
+#include "exprs/nary.hh"
 #include "exprs/unary.hh"
 #include "formula.hh"
+#include "free_variable.hh"
+#include "frontier.hh"
+#include "model_finder.hh"
+#include "portfolio.hh"
 #include "tableau.hh"
 #include "tokenizer.hh"
+#include "tracer.hh"
 #include "utils/helper.hh"
+#include "utils/serialize.hh"
 #include "visitor/children_visitor.hh"
 #include "visitor/info_visitor.hh"
 
@@ -50,11 +62,13 @@ auto Flatten(std::vector<Expr *> &flatten, std::vector<uint64_t> &parents,
   }
 }
 
+// Return the number of exprs that are copied
 auto Merge(const Token &src, std::vector<Expr *> &flatten,
            std::vector<uint64_t> &parents,
            std::vector<std::vector<std::shared_ptr<Expr>>> &to_merge,
-           const Token &dst) -> void {
-  for (auto i = to_merge.size() - 1; i > 0; --i) {
+           const Token &dst) -> uint64_t {
+  uint64_t copied{0};
+  for (auto i = to_merge.size() - 1; i > 0; --i, ++copied) {
     const auto flattened_type = flatten[i]->Type();
 
     if (ExprKind::IsLiteral(flattened_type)) { // Literal => constructs literal
@@ -69,6 +83,13 @@ auto Merge(const Token &src, std::vector<Expr *> &flatten,
       continue;
     }
 
+    if (ExprKind::IsBinary(flattened_type) &&
+        to_merge[i].size() > 2) { // Construct Nary
+      to_merge[parents[i]].push_back(
+          std::make_shared<NaryExpr>(flattened_type, std::move(to_merge[i])));
+      continue;
+    }
+
     if (ExprKind::IsBinary(flattened_type)) { // Construct Binary
       to_merge[parents[i]].push_back(std::make_shared<BinaryExpr>(
           flattened_type, std::move(to_merge[i][0]),
@@ -84,6 +105,7 @@ auto Merge(const Token &src, std::vector<Expr *> &flatten,
 
       if (infos[0] == src) { // if variable is re-bounded => DO a simple copy
         to_merge[parents[i]].push_back(std::move(to_merge[i][0]));
+        --copied;
       } else { // otherwise => Construct Quantified Expr
         to_merge[parents[i]].push_back(std::make_shared<QuantifiedUnaryExpr>(
             flattened_type, std::move(infos[0]), std::move(to_merge[i][0])));
@@ -99,15 +121,19 @@ auto Merge(const Token &src, std::vector<Expr *> &flatten,
 
     unreachable();
   }
+  return copied;
 }
 
-auto CopyAndReplace(const Token &src, std::shared_ptr<Expr> expr,
-                    const Token &dst) -> std::shared_ptr<Expr> {
-  // Potential Optimization Here
-  // Encapsulate them inside a struct is better for locality
-  std::vector<Expr *> flatten{{}, expr.get()};
-  std::vector<uint64_t> parents{0, 0};
-  std::vector<std::vector<std::shared_ptr<Expr>>> to_merge{{}, {}};
+// Flatten expr for Merge, which replaces src in a copy of it
+// expr must outlive flatten (it only holds raw pointers)
+auto FlattenForCopy(const Token &src, const std::shared_ptr<Expr> &expr,
+                    std::vector<Expr *> &flatten,
+                    std::vector<uint64_t> &parents,
+                    std::vector<std::vector<std::shared_ptr<Expr>>> &to_merge)
+    -> void {
+  flatten = {{}, expr.get()};
+  parents = {0, 0};
+  to_merge = {{}, {}};
 
   InfoVisitor info_visitor;
   expr->Accept(info_visitor);
@@ -118,40 +144,132 @@ auto CopyAndReplace(const Token &src, std::shared_ptr<Expr> expr,
       info_visitor.Infos()[0] == src) {
     // If var is bounded by new quantifier, store it to to_merge directly
     // we will then merge it by checking the same condition
-    to_merge[1].push_back(std::move(expr));
+    to_merge[1].push_back(expr);
   }
 
   // Flatten the AST
   Flatten(flatten, parents, to_merge, src);
 
   assert(to_merge.size() == flatten.size());
+}
+
+auto CopyAndReplace(const Token &src, const std::shared_ptr<Expr> &expr,
+                    const Token &dst, TableauStats &stats)
+    -> std::shared_ptr<Expr> {
+  const AllocationScope allocation_scope{
+      AllocationProfiler::Phase::kSubstitute};
+
+  // Potential Optimization Here
+  // Encapsulate them inside a struct is better for locality
+  std::vector<Expr *> flatten;
+  std::vector<uint64_t> parents;
+  std::vector<std::vector<std::shared_ptr<Expr>>> to_merge;
+  FlattenForCopy(src, expr, flatten, parents, to_merge);
 
   // Merge back all the changes
-  Merge(src, flatten, parents, to_merge, dst);
+  stats.nodes_copied += Merge(src, flatten, parents, to_merge, dst);
 
   return std::move(to_merge[0][0]);
 }
 
-[[nodiscard]] auto Expand(std::shared_ptr<Expr> expr, const Token &token)
-    -> std::vector<std::vector<std::shared_ptr<Expr>>> {
+// Same as CopyAndReplace for every token of [first, last), where expr is
+// only flattened once
+auto CopyAndReplaceAll(const Token &src, const std::shared_ptr<Expr> &expr,
+                       std::vector<Token>::const_iterator first,
+                       std::vector<Token>::const_iterator last,
+                       TableauStats &stats)
+    -> std::vector<std::shared_ptr<Expr>> {
+  const AllocationScope allocation_scope{
+      AllocationProfiler::Phase::kSubstitute};
+
+  std::vector<Expr *> flatten;
+  std::vector<uint64_t> parents;
+  std::vector<std::vector<std::shared_ptr<Expr>>> to_merge;
+  FlattenForCopy(src, expr, flatten, parents, to_merge);
+
+  std::vector<std::shared_ptr<Expr>> copies;
+  copies.reserve(static_cast<std::size_t>(last - first));
+  for (; first != last; ++first) {
+    // Merge consumes to_merge, so the last copy takes it over
+    auto merged = first + 1 == last ? std::move(to_merge) : to_merge;
+    stats.nodes_copied += Merge(src, flatten, parents, merged, *first);
+    copies.push_back(std::move(merged[0][0]));
+  }
+  return copies;
+}
+
+// Negate expr, removing its negation if it has one
+auto Negate(std::shared_ptr<Expr> expr) -> std::shared_ptr<Expr> {
+  if (expr->Type() == ExprKind::kNeg) {
+    ChildrenVisitor children_visitor;
+    expr->Accept(children_visitor);
+    return std::move(children_visitor.ViewChildren()[0]);
+  }
+  return std::make_shared<UnaryExpr>(ExprKind::kNeg, std::move(expr));
+}
+
+// Add a branch with the formulas of exprs to expansion
+template <typename... Exprs>
+auto AddBranch(Expansion &expansion, Exprs &&...exprs) -> void {
+  expansion.AddBranch();
+  (expansion.Add(TableauFormula{std::forward<Exprs>(exprs)}), ...);
+}
+
+auto Expand(std::shared_ptr<Expr> expr, const Token &token,
+            const TableauOptions &options, TableauStats &stats,
+            Expansion &expansion) -> void {
   ChildrenVisitor children_visitor;
   expr->Accept(children_visitor);
   auto &childrens = children_visitor.ViewChildren();
 
   const auto expr_type = expr->Type();
 
-  if (expr_type == ExprKind::kAnd) { // Alpha expansion
-    return {std::move(childrens)};
+  if (expr_type == ExprKind::kAnd) { // Alpha expansion (all the conjuncts)
+    expansion.Reserve(1, childrens.size());
+    expansion.AddBranch();
+    for (auto &children : childrens) {
+      expansion.Add(TableauFormula{std::move(children)});
+    }
+    return;
+  }
+
+  // Semantic branching: (AvB) => {A}, {-A, B} and (A>B) => {-A}, {A, B}
+  // The right branch additionally refutes the left one
+  // (AvBvC) => {A}, {-A, (BvC)}, so that the branches stay disjoint
+  if (expr_type == ExprKind::kOr && options.semantic_branching) {
+    auto negated = Negate(childrens[0]);
+    std::shared_ptr<Expr> rest =
+        childrens.size() == 2
+            ? std::move(childrens[1])
+            : std::make_shared<NaryExpr>(
+                  ExprKind::kOr,
+                  std::vector(std::make_move_iterator(childrens.begin() + 1),
+                              std::make_move_iterator(childrens.end())));
+    AddBranch(expansion, std::move(childrens[0]));
+    AddBranch(expansion, std::move(negated), std::move(rest));
+    return;
   }
 
-  if (expr_type == ExprKind::kOr) { // Beta expansion
-    return {{std::move(childrens[0])}, {std::move(childrens[1])}};
+  if (expr_type == ExprKind::kImpl && options.semantic_branching) {
+    auto negated = Negate(childrens[0]);
+    AddBranch(expansion, std::move(negated));
+    AddBranch(expansion, std::move(childrens[0]), std::move(childrens[1]));
+    return;
+  }
+
+  if (expr_type == ExprKind::kOr) { // Beta expansion (one branch per disjunct)
+    expansion.Reserve(childrens.size(), childrens.size());
+    for (auto &children : childrens) {
+      AddBranch(expansion, std::move(children));
+    }
+    return;
   }
 
   if (expr_type == ExprKind::kImpl) { // Beta expansion
-    return {
-        {std::make_shared<UnaryExpr>(ExprKind::kNeg, std::move(childrens[0]))},
-        {std::move(childrens[1])}};
+    AddBranch(expansion, std::make_shared<UnaryExpr>(ExprKind::kNeg,
+                                                     std::move(childrens[0])));
+    AddBranch(expansion, std::move(childrens[1]));
+    return;
   }
 
   if (expr_type == ExprKind::kExist || expr_type == ExprKind::kUniversal) {
@@ -168,8 +286,9 @@ auto CopyAndReplace(const Token &src, std::shared_ptr<Expr> expr,
     */
     InfoVisitor info_visitor;
     expr->Accept(info_visitor);
-    return {{CopyAndReplace(info_visitor.Infos()[0], std::move(childrens[0]),
-                            token)}};
+    AddBranch(expansion, CopyAndReplace(info_visitor.Infos()[0],
+                                        std::move(childrens[0]), token, stats));
+    return;
   }
 
   if (expr_type == ExprKind::kNeg) {
@@ -180,7 +299,8 @@ auto CopyAndReplace(const Token &src, std::shared_ptr<Expr> expr,
     // If we are negating literal, we return Neg+Literal
     // by the definition of literals in Tableau
     if (neg_expr_child_type == ExprKind::kLiteral) {
-      return {{std::move(expr)}};
+      AddBranch(expansion, std::move(expr));
+      return;
     }
 
     ChildrenVisitor children_visitor_for_children;
@@ -190,7 +310,8 @@ auto CopyAndReplace(const Token &src, std::shared_ptr<Expr> expr,
     // If Unary
     // If Neg, we skip the double Negation
     if (neg_expr_child_type == ExprKind::kNeg) {
-      return {{std::move(children_of_children[0])}};
+      AddBranch(expansion, std::move(children_of_children[0]));
+      return;
     }
 
     // Otherwise, we negate the Quantified Formula based on their rule
@@ -201,10 +322,24 @@ auto CopyAndReplace(const Token &src, std::shared_ptr<Expr> expr,
       auto &infos = info_visitor.Infos();
       assert(infos.size() == 1);
 
-      return {{std::make_shared<QuantifiedUnaryExpr>(
-          ExprKind::Negate(neg_expr_child_type), std::move(infos[0]),
-          std::make_shared<UnaryExpr>(ExprKind::kNeg,
-                                      std::move(children_of_children[0])))}};
+      AddBranch(expansion,
+                std::make_shared<QuantifiedUnaryExpr>(
+                    ExprKind::Negate(neg_expr_child_type), std::move(infos[0]),
+                    std::make_shared<UnaryExpr>(
+                        ExprKind::kNeg, std::move(children_of_children[0]))));
+      return;
+    }
+
+    // If Nary => -(A^B^C) is (-Av-Bv-C) and -(AvBvC) is (-A^-B^-C)
+    if (children_of_children.size() > 2) {
+      for (auto &operand : children_of_children) {
+        operand =
+            std::make_shared<UnaryExpr>(ExprKind::kNeg, std::move(operand));
+      }
+      AddBranch(expansion, std::make_shared<NaryExpr>(
+                               ExprKind::Negate(neg_expr_child_type),
+                               std::move(children_of_children)));
+      return;
     }
 
     // If Binary => we negate them based on their rules
@@ -219,19 +354,68 @@ auto CopyAndReplace(const Token &src, std::shared_ptr<Expr> expr,
       std::shared_ptr<Expr> node = std::make_shared<BinaryExpr>(
           ExprKind::Negate(neg_expr_child_type), std::move(new_children_left),
           std::move(new_children_right));
-      return {{std::move(node)}};
+      AddBranch(expansion, std::move(node));
+      return;
     }
   }
 
   unreachable();
 }
+
+// The rule applied when expanding a formula of this type
+auto RuleStatsOf(TableauStats &stats, ExprKind type)
+    -> TableauStats::RuleStats & {
+  switch (type) {
+  case ExprKind::kAnd:
+    return stats.alpha;
+  case ExprKind::kOr:
+  case ExprKind::kImpl:
+    return stats.beta;
+  case ExprKind::kUniversal:
+    return stats.gamma;
+  case ExprKind::kExist:
+    return stats.delta;
+  case ExprKind::kNeg:
+    return stats.negation;
+  case ExprKind::kNull:
+  case ExprKind::kLiteral:
+    break;
+  }
+  unreachable();
+}
 } // namespace
 
-[[nodiscard]] auto TableauFormula::Expand(ConstantManager &manager)
-    -> std::vector<std::vector<TableauFormula>> {
+auto TableauFormula::Expand(ConstantManager &manager,
+                            const TableauOptions &options, TableauStats &stats,
+                            Expansion &expansion) -> void {
+  expansion.Clear();
   Token token;
   const auto type = Type();
 
+  if (type == ExprKind::kUniversal && options.batch_gamma) {
+    /*
+      Batch gamma => instantiate the formula with all the constants it was
+      not instantiated with yet, in one step
+        - it is then parked in the queue (see FormulaQueue) until a delta
+          expansion adds a new constant
+    */
+    const auto &consts = manager.Consts();
+    if (const_num_ >= consts.size()) {
+      return;
+    }
+
+    auto instances = InstantiateAll(
+        consts.begin() + static_cast<std::ptrdiff_t>(const_num_), consts.end(),
+        stats);
+    expansion.Reserve(1, instances.size());
+    expansion.AddBranch();
+    for (auto &instance : instances) {
+      expansion.Add(std::move(instance));
+    }
+    const_num_ = consts.size();
+    return;
+  }
+
   if (type == ExprKind::kUniversal) {
     /*
       if Universal Formula => we need to get a constant based on
@@ -240,7 +424,7 @@ auto CopyAndReplace(const Token &src, std::shared_ptr<Expr> expr,
     */
     std::optional requested_const = manager.GetConsts(const_num_);
     if (!requested_const.has_value()) {
-      return {};
+      return;
     }
     ++const_num_;
     token = std::move(requested_const.value());
@@ -250,88 +434,373 @@ auto CopyAndReplace(const Token &src, std::shared_ptr<Expr> expr,
         - the availability of the constant manager
     */
     if (!manager.CanAddConst()) {
-      return {};
+      return;
     }
     token = manager.AddConst();
+    ++stats.constants_introduced;
   }
 
-  /*
-    Try to expand and Encapsulate all back to the TableauFormula
+  // The new exprs are wrapped into TableauFormulas as they are added, which
+  // manages the lifetime of their shared_ptr
+  ::Expand(expr_, token, options, stats, expansion);
+}
 
-    This provides encapsulation and also ensures that the lifetime of the
-    shared_ptr is properly managed
-  */
-  std::vector expansion = ::Expand(expr_, token);
-  std::vector<std::vector<TableauFormula>> ret;
-  ret.reserve(expansion.size());
+auto TableauFormula::Instantiate(const Token &token, TableauStats &stats) const
+    -> TableauFormula {
+  assert(Type() == ExprKind::kExist || Type() == ExprKind::kUniversal);
 
-  for (auto &one_expansion : expansion) {
-    std::vector<TableauFormula> formulas;
-    formulas.reserve(one_expansion.size());
-    for (auto &new_formula : one_expansion) {
-      formulas.emplace_back(std::move(new_formula));
-    }
-    ret.push_back(std::move(formulas));
+  ChildrenVisitor children_visitor;
+  expr_->Accept(children_visitor);
+  InfoVisitor info_visitor;
+  expr_->Accept(info_visitor);
+
+  return TableauFormula{CopyAndReplace(info_visitor.Infos()[0],
+                                       children_visitor.ViewChildren()[0],
+                                       token, stats)};
+}
+
+auto TableauFormula::InstantiateAll(std::vector<Token>::const_iterator first,
+                                    std::vector<Token>::const_iterator last,
+                                    TableauStats &stats) const
+    -> std::vector<TableauFormula> {
+  assert(Type() == ExprKind::kExist || Type() == ExprKind::kUniversal);
+
+  ChildrenVisitor children_visitor;
+  expr_->Accept(children_visitor);
+  InfoVisitor info_visitor;
+  expr_->Accept(info_visitor);
+
+  auto copies = CopyAndReplaceAll(info_visitor.Infos()[0],
+                                  children_visitor.ViewChildren()[0], first,
+                                  last, stats);
+  std::vector<TableauFormula> formulas;
+  formulas.reserve(copies.size());
+  for (auto &copy : copies) {
+    formulas.emplace_back(std::move(copy));
+  }
+  return formulas;
+}
+
+auto TableauFormula::Serialize(std::string &out) const -> void {
+  Formula::Serialize(out);
+  WriteInteger(out, const_num_);
+}
+
+auto TableauFormula::Deserialize(std::string_view &in) -> TableauFormula {
+  TableauFormula formula{Formula::Deserialize(in)};
+  formula.const_num_ = ReadInteger(in);
+  return formula;
+}
+
+FormulaQueue::~FormulaQueue() {
+  for (auto &bucket : buckets_) {
+    Release(std::move(bucket));
+  }
+}
+
+FormulaQueue::FormulaQueue(FormulaQueue &&other) noexcept
+    : buckets_{std::move(other.buckets_)},
+      size_{std::exchange(other.size_, 0)},
+      tree_bytes_{std::exchange(other.tree_bytes_, 0)} {}
+
+auto FormulaQueue::operator=(FormulaQueue other) noexcept -> FormulaQueue & {
+  std::swap(buckets_, other.buckets_);
+  std::swap(size_, other.size_);
+  std::swap(tree_bytes_, other.tree_bytes_);
+  return *this;
+}
+
+auto FormulaQueue::BucketOf(const TableauFormula &formula) -> std::size_t {
+  const auto type = formula.Type();
+  if (type == ExprKind::kUniversal) {
+    return kRuleBuckets +
+           static_cast<std::size_t>(
+               std::min(formula.const_num_, ConstantManager::Limit()));
+  }
+  assert(type >= ExprKind::kNeg && type <= ExprKind::kImpl);
+  return static_cast<std::size_t>(type - ExprKind::kNeg);
+}
+
+auto FormulaQueue::TopBucket() const -> std::size_t {
+  assert(!Empty());
+  std::size_t bucket{0};
+  while (buckets_[bucket] == nullptr) {
+    ++bucket;
+  }
+  return bucket;
+}
+
+auto FormulaQueue::Top() const -> const TableauFormula & {
+  return buckets_[TopBucket()]->formula;
+}
+
+auto FormulaQueue::Push(TableauFormula formula) -> void {
+  auto &bucket = buckets_[BucketOf(formula)];
+  tree_bytes_ += formula.TreeBytes();
+  bucket = std::make_shared<Node>(Node{std::move(formula), std::move(bucket)});
+  ++size_;
+}
+
+auto FormulaQueue::Pop() -> TableauFormula {
+  auto &bucket = buckets_[TopBucket()];
+  auto node = std::move(bucket);
+  bucket = node->next;
+  --size_;
+  tree_bytes_ -= node->formula.TreeBytes();
+  // the node may still be in the queue of another branch
+  if (node.use_count() == 1) {
+    auto formula = std::move(node->formula);
+    Release(std::move(node));
+    return formula;
+  }
+  return node->formula;
+}
+
+auto FormulaQueue::Release(std::shared_ptr<Node> node) -> void {
+  while (node != nullptr && node.use_count() == 1) {
+    node = std::move(node->next);
   }
+}
+
+auto FormulaSet::Find(const Node &node, std::size_t hash,
+                      const Formula &formula) -> bool {
+  return std::any_of(node.entries.begin(), node.entries.end(),
+                     [hash, &formula](const Entry &entry) {
+                       return entry.hash == hash && entry.formula == formula;
+                     });
+}
 
-  return ret;
+auto FormulaSet::Contains(const Formula &formula) const -> bool {
+  const auto hash = formula.Hash();
+  const Node *node = root_.get();
+  for (unsigned depth = 0; node != nullptr; ++depth) {
+    if (Find(*node, hash, formula)) {
+      return true;
+    }
+    // the children of a node are only used once it is full
+    if (!Full(*node, depth)) {
+      return false;
+    }
+    node = node->children[ChildOf(hash, depth)].get();
+  }
+  return false;
 }
 
-auto operator>(const TableauFormula &lhs, const TableauFormula &rhs) -> bool {
-  const auto lhs_type = lhs.Type();
-  const auto rhs_type = rhs.Type();
-  if (lhs_type == rhs_type && lhs_type == ExprKind::kUniversal) {
-    return lhs.const_num_ > rhs.const_num_;
+auto FormulaSet::Insert(const Formula &formula) -> bool {
+  const auto hash = formula.Hash();
+  auto *slot = &root_;
+  for (unsigned depth = 0;; ++depth) {
+    if (*slot == nullptr) {
+      *slot = std::make_shared<Node>();
+    } else if (slot->use_count() > 1) {
+      // shared with another branch, which must not see the formula
+      *slot = std::make_shared<Node>(**slot);
+    }
+
+    auto &node = **slot;
+    if (Find(node, hash, formula)) {
+      return false;
+    }
+    if (!Full(node, depth)) {
+      node.entries.push_back(Entry{hash, formula});
+      ++size_;
+      tree_bytes_ += formula.TreeBytes();
+      return true;
+    }
+    slot = &node.children[ChildOf(hash, depth)];
   }
-  return lhs_type > rhs_type;
 }
 
 // An encapsulation of Append
 // Help us to filter out literal and Assign formula to their appropriate
 // structure
-auto Theory::Append(const TableauFormula &formula) -> void {
+auto Theory::Append(const TableauFormula &formula) -> bool {
   const auto formula_type = formula.Type();
 
-  if (ExprKind::IsLiteral(
-          formula_type)) { // if tableau literal => literal or neg_literal
-    // use description to deal with prop literal and pred literal
-    auto literal = formula.Description();
-    if (neg_literals_.find(Token{literal}) != neg_literals_.end()) {
+  // if tableau literal => literal or neg_literal, compared by their keys
+  // (the same for prop literal and pred literal)
+  // Only one negation is looked at, so that a long chain of negations is not
+  // walked again each time one of them is expanded
+  if (const auto literal = formula.ViewLiteral(1); literal.literal) {
+    const bool negated = literal.negations == 1;
+    if ((negated ? literals_ : neg_literals_).count(literal.key) != 0) {
       close_ = true;
     } else {
-      literals_.emplace(std::move(literal));
+      (negated ? neg_literals_ : literals_).insert(literal.key);
+      // the beta formulas with a side on this key can now be propagated
+      // (watches_ stays empty without propagation)
+      if (const auto it = watches_.find(literal.key); it != watches_.end()) {
+        ready_.insert(ready_.end(), it->second->begin(), it->second->end());
+        watched_ -= it->second->size();
+        watches_.erase(it);
+      }
     }
-    return;
+    return false;
   }
 
-  if (formula_type == ExprKind::kNeg &&
-      ExprKind::IsLiteral(formula.ViewChildren()[0].Type())) {
-    auto literal = formula.ViewChildren()[0].Description();
-    if (literals_.find(Token{literal}) != literals_.end()) {
-      close_ = true;
-    } else {
-      neg_literals_.emplace(std::move(literal));
+  // Any non-gamma formula only needs to be expanded once per branch
+  // Gamma formulas are re-queued on purpose after each instantiation
+  // A negation is expanded into a single formula, which is checked in turn,
+  // so checking the negation too would only grow queued_
+  if (formula_type != ExprKind::kUniversal && formula_type != ExprKind::kNeg &&
+      !queued_.Insert(formula)) {
+    return false;
+  }
+
+  formulas_.Push(formula); // otherwise, go to the queue of its rule
+  if (propagation_ && ExprKind::IsBeta(formula_type)) {
+    Watch(formula);
+  }
+  return true;
+}
+
+auto Theory::Watch(const TableauFormula &formula) -> void {
+  // (AvB) has the sides A and B, (A>B) has the sides -A and B
+  // (AvBvC) has the sides A, B and C
+  // Either value of a side is enough, so the negations do not matter
+  std::vector<LiteralTable::Key> keys;
+  for (const auto &side : formula.ViewChildren()) {
+    const auto literal =
+        side.ViewLiteral(std::numeric_limits<uint64_t>::max());
+    if (!literal.literal) {
+      continue;
+    }
+    if (literals_.count(literal.key) != 0 ||
+        neg_literals_.count(literal.key) != 0) {
+      ready_.push_back(formula);
+      return;
+    }
+    keys.push_back(literal.key);
+  }
+
+  for (const auto key : keys) {
+    auto &watch = watches_[key];
+    if (watch == nullptr) {
+      watch = std::make_shared<std::vector<TableauFormula>>();
+    } else if (watch.use_count() > 1) {
+      // shared with another branch, which must not see the formula
+      watch = std::make_shared<std::vector<TableauFormula>>(*watch);
+    }
+    watch->push_back(formula);
+  }
+  watched_ += keys.size();
+}
+
+auto Theory::Contains(const Formula &formula) const -> bool {
+  if (const auto literal = formula.ViewLiteral(1); literal.literal) {
+    return (literal.negations == 1 ? neg_literals_ : literals_)
+               .count(literal.key) != 0;
+  }
+  return queued_.Contains(formula);
+}
+
+/*
+  Liberalized delta rule: if E(x)A(x) has an instance A(c) on the branch,
+  then c is a witness of it, and a new constant would only make the branch
+  longer. Any model of the branch satisfies E(x)A(x) through c, and an open
+  branch still has a witness for it, so both results are unchanged.
+*/
+auto Theory::HasWitness(const TableauFormula &formula,
+                        TableauStats &stats) const -> bool {
+  const auto &consts = manager_.Consts();
+  if (consts.empty()) {
+    return false;
+  }
+  const auto instances =
+      formula.InstantiateAll(consts.begin(), consts.end(), stats);
+  return std::any_of(
+      instances.begin(), instances.end(),
+      [this](const TableauFormula &instance) { return Contains(instance); });
+}
+
+auto Theory::Evaluate(const Formula &formula, bool negated) const
+    -> LiteralStatus {
+  const auto literal =
+      formula.ViewLiteral(std::numeric_limits<uint64_t>::max());
+  if (!literal.literal) {
+    return LiteralStatus::kUnknown;
+  }
+  negated = negated != (literal.negations % 2 == 1);
+
+  if ((negated ? neg_literals_ : literals_).count(literal.key) != 0) {
+    return LiteralStatus::kTrue;
+  }
+  if ((negated ? literals_ : neg_literals_).count(literal.key) != 0) {
+    return LiteralStatus::kFalse;
+  }
+  return LiteralStatus::kUnknown;
+}
+
+/*
+  Beta formulas are only popped after all the alpha/delta formulas, i.e. when
+  the literals of the branch are as complete as they can be before a split.
+  At this point, a beta formula with a side whose value is already known
+  does not need to split (see TryExpand), so we expand it first.
+
+  Such formulas are found through the keys of their literal sides (see
+  Watch), so appending a literal only visits the formulas it affects. A
+  formula expanded from ready_ stays in formulas_, and the other way
+  around: expanded_ tells which copies to skip.
+*/
+auto Theory::NextFormula() -> std::optional<TableauFormula> {
+  if (propagation_ && ExprKind::IsBeta(formulas_.Top().Type())) {
+    while (!ready_.empty()) {
+      auto formula = std::move(ready_.back());
+      ready_.pop_back();
+      if (expanded_.Insert(formula)) {
+        return formula;
+      }
     }
-    return;
   }
 
-  formulas_.emplace(formula); // otherwise, go to priority_queue
+  while (!formulas_.Empty()) {
+    auto formula = formulas_.Pop();
+    if (!propagation_ || !ExprKind::IsBeta(formula.Type()) ||
+        expanded_.Insert(formula)) {
+      return formula;
+    }
+  }
+  return {};
 }
 
-auto Theory::TryExpand() -> std::vector<Theory> {
-  if (formulas_.empty()) {
-    return {};
+auto Theory::TryExpand(const TableauOptions &options, TableauStats &stats,
+                       std::vector<Theory> &theories) -> void {
+  theories.clear();
+  if (formulas_.Empty()) {
+    return;
+  }
+
+  // Only read the clock if asked to, as this is called for every rule
+  const auto start = options.collect_stats
+                         ? std::chrono::steady_clock::now()
+                         : std::chrono::steady_clock::time_point{};
+
+  const AllocationScope allocation_scope{AllocationProfiler::Phase::kExpand};
+  auto next = NextFormula();
+  if (!next.has_value()) {
+    return;
+  }
+  auto formula = std::move(*next);
+
+  TraceSpan span{"Theory::TryExpand", true};
+  if (span.Recording()) {
+    span.AddArgument("connective", std::string{formula.Connective()});
   }
 
-  auto formula = formulas_.top();
-  formulas_.pop();
+  const auto formula_type = formula.Type();
 
   // Try expanding the formula, if we cannot expand
   //  - reach constant limits
   //  - no more available const for universal formula
-  auto expansions = formula.Expand(manager_);
-
-  const auto formula_type = formula.Type();
+  // An existential formula with a witness on the branch is simply dropped
+  Expansion expansions;
+  if (formula_type == ExprKind::kExist && options.reuse_constants &&
+      HasWitness(formula, stats)) {
+    ++stats.constants_reused;
+    expansions.AddBranch();
+  } else {
+    formula.Expand(manager_, options, stats, expansions);
+  }
 
   /*
     After trying to expand there are only three possibilities:
@@ -343,46 +812,245 @@ auto Theory::TryExpand() -> std::vector<Theory> {
         - no way for other possible A to generate more consts because the A
           is pop-ed based on their const_num
 
-    In the second case, we need to mark our theory as undecidable
+    In the second case, we need to mark our theory as undecidable. The
+    formula is dropped, as it can never be expanded on this branch, so that
+    the other formulas can still be expanded if the theory is extended later
+    (see IncrementalTableau).
+
+    In the third case, the formula is put back for the constants to come.
   */
-  if (expansions.empty()) {
+  if (expansions.Empty()) {
     if (formula_type == ExprKind::kExist) {
       undecidable_ = true;
+    } else {
+      formulas_.Push(std::move(formula));
     }
-    return {};
+    return;
   }
 
-  std::vector<Theory> new_theories;
-  new_theories.reserve(expansions.size());
+  /*
+    Propagation: before splitting on a beta formula
+      - if all the formulas of a branch already hold, the beta formula holds,
+        so we simply drop it
+      - a branch with a refuted formula would be closed right away, so we
+        don't create it
+      - if all the branches are refuted, the theory is closed
+  */
+  if (options.propagation && ExprKind::IsBeta(formula_type)) {
+    const auto branches = expansions.Branches();
+    const auto has_status = [this](const TableauFormula &new_formula,
+                                   LiteralStatus status) {
+      return Evaluate(new_formula, false) == status;
+    };
+
+    bool satisfied{false};
+    for (std::size_t i = 0; i < branches && !satisfied; ++i) {
+      const auto branch = expansions[i];
+      satisfied = std::all_of(branch.begin(), branch.end(),
+                              [&has_status](const auto &new_formula) {
+                                return has_status(new_formula,
+                                                  LiteralStatus::kTrue);
+                              });
+    }
+
+    if (satisfied) {
+      expansions.Clear();
+      expansions.AddBranch();
+    } else {
+      expansions.RemoveBranchesIf(
+          [&has_status](const Expansion::Branch &branch) {
+            return std::any_of(branch.begin(), branch.end(),
+                               [&has_status](const auto &new_formula) {
+                                 return has_status(new_formula,
+                                                   LiteralStatus::kFalse);
+                               });
+          });
+    }
+
+    if (expansions.Branches() < branches) {
+      ++stats.propagations;
+    }
+    if (expansions.Empty()) {
+      close_ = true;
+      expansions.AddBranch();
+    }
+  }
 
-  for (auto &expansion : expansions) {
-    Theory new_theory = *this;
-    for (const auto &new_formula : expansion) {
+  const auto branches = expansions.Branches();
+  theories.reserve(branches);
+
+  for (std::size_t i = 0; i < branches; ++i) {
+    // The last branch takes over this theory instead of copying it
+    auto &new_theory = theories.emplace_back([&] {
+      const AllocationScope copy_scope{AllocationProfiler::Phase::kTheoryCopy};
+      return i + 1 == branches ? std::move(*this) : *this;
+    }());
+    // A closed theory is dropped, so the rest of a wide expansion is not
+    // needed
+    for (const auto &new_formula : expansions[i]) {
       new_theory.Append(new_formula);
+      if (new_theory.Close()) {
+        break;
+      }
     }
 
     // Gamma formula needs to be added back to the Theory
     if (formula_type == ExprKind::kUniversal) {
       new_theory.Append(formula);
     }
+  }
+
+  stats.branches_created += branches - 1;
+  stats.theory_copies += branches - 1;
+
+  auto &rule_stats = RuleStatsOf(stats, formula_type);
+  ++rule_stats.count;
+  if (options.collect_stats) {
+    rule_stats.nanoseconds += static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start)
+            .count());
+  }
+}
+
+auto Theory::ApproximateSize() const -> uint64_t {
+  // every entry of the hash sets also pays for a node (next pointer + hash)
+  constexpr uint64_t kNodeOverhead = 2 * sizeof(void *);
+  // The exprs are counted as Deserialize rebuilds them: one unshared tree
+  // per formula of formulas_ and of queued_. That is close for a refilled
+  // theory, and an overestimate for one that was never spilled, whose
+  // exprs are shared with the input, with the other theories and between
+  // formulas_ and queued_, as are the nodes of formulas_ and queued_
+  // themselves (so such theories spill earlier than they need to). Tokens
+  // longer than the small string buffer and the buckets of the hash sets
+  // are not counted.
+  return sizeof(Theory) +
+         formulas_.Size() * (sizeof(TableauFormula) + kNodeOverhead) +
+         formulas_.TreeBytes() +
+         queued_.Size() * (sizeof(Formula) + kNodeOverhead) +
+         queued_.TreeBytes() +
+         expanded_.Size() * (sizeof(Formula) + kNodeOverhead) +
+         expanded_.TreeBytes() +
+         (watched_ + ready_.size()) * sizeof(TableauFormula) +
+         watches_.size() *
+             (sizeof(LiteralTable::Key) + sizeof(void *) + kNodeOverhead) +
+         (literals_.size() + neg_literals_.size()) *
+             (sizeof(LiteralTable::Key) + kNodeOverhead);
+}
+
+auto Theory::Serialize(std::string &out) const -> void {
+  // in the order of Pop (the copy shares the nodes of formulas_)
+  auto formulas = formulas_;
+  WriteInteger(out, formulas.Size());
+  while (!formulas.Empty()) {
+    formulas.Pop().Serialize(out);
+  }
+
+  for (const auto *literals : {&literals_, &neg_literals_}) {
+    WriteInteger(out, literals->size());
+    for (const auto &literal : *literals) {
+      WriteInteger(out, literal);
+    }
+  }
+
+  WriteInteger(out, queued_.Size());
+  queued_.ForEach([&out](const Formula &formula) { formula.Serialize(out); });
+
+  // watches_ and ready_ are rebuilt from formulas_ (see Deserialize)
+  WriteInteger(out, static_cast<uint64_t>(propagation_));
+  WriteInteger(out, expanded_.Size());
+  expanded_.ForEach(
+      [&out](const Formula &formula) { formula.Serialize(out); });
+
+  // constants are always named by their index, so the count is enough
+  WriteInteger(out, manager_.Size());
+  WriteInteger(out, static_cast<uint64_t>(undecidable_));
+  WriteInteger(out, static_cast<uint64_t>(close_));
+}
+
+auto Theory::Deserialize(std::string_view &in) -> Theory {
+  Theory theory;
+
+  std::vector<TableauFormula> formulas;
+  for (auto count = ReadInteger(in); count > 0; --count) {
+    formulas.push_back(TableauFormula::Deserialize(in));
+  }
+
+  for (auto *literals : {&theory.literals_, &theory.neg_literals_}) {
+    for (auto count = ReadInteger(in); count > 0; --count) {
+      literals->insert(static_cast<LiteralTable::Key>(ReadInteger(in)));
+    }
+  }
+
+  for (auto count = ReadInteger(in); count > 0; --count) {
+    theory.queued_.Insert(Formula::Deserialize(in));
+  }
+
+  theory.propagation_ = ReadInteger(in) != 0;
+  for (auto count = ReadInteger(in); count > 0; --count) {
+    theory.expanded_.Insert(Formula::Deserialize(in));
+  }
+
+  // pushed back in reverse, so that they are popped in the same order
+  // The beta formulas not expanded yet are watched again, now that the
+  // literals are known
+  for (auto it = formulas.rbegin(); it != formulas.rend(); ++it) {
+    if (theory.propagation_ && ExprKind::IsBeta(it->Type()) &&
+        !theory.expanded_.Contains(*it)) {
+      theory.Watch(*it);
+    }
+    theory.formulas_.Push(std::move(*it));
+  }
 
-    new_theories.push_back(std::move(new_theory));
+  for (auto count = ReadInteger(in); count > 0; --count) {
+    theory.manager_.AddConst();
   }
+  theory.undecidable_ = ReadInteger(in) != 0;
+  theory.close_ = ReadInteger(in) != 0;
 
-  return new_theories;
+  return theory;
 }
 
-auto Tableau::Solve(const Parser::ParserOutput &parser_out) -> TableauResult {
-  std::vector<Theory> queue;
-  queue.emplace_back(TableauFormula(parser_out.GetFormula()));
+auto Tableau::Solve(const Parser::ParserOutput &parser_out,
+                    const TableauOptions &options) -> TableauOutput {
+  if (options.portfolio) {
+    return Portfolio::Solve(parser_out, options);
+  }
+
+  const TraceSpan span{"Tableau::Solve"};
+
+  TableauStats stats;
+
+  // A closed free-variable tableau is a definite answer, whereas the ground
+  // tableau below may run out of constants
+  if (options.free_variable_depth != 0 &&
+      parser_out.Result() == Parser::ParseResult::kPredicate &&
+      FreeVariableTableau::Refute(parser_out.GetFormula(),
+                                  options.free_variable_depth, options,
+                                  stats)) {
+    return TableauOutput{TableauResult::kUnsatisfiable, stats};
+  }
+
+  // Wide conjunctions/disjunctions are expanded in one step instead of one
+  // per level of their chain
+  Frontier frontier{options.memory_budget, options.depth_first};
+  frontier.Push(
+      Theory{TableauFormula(parser_out.GetFormula().FlattenConnectives()),
+             options.propagation});
 
   bool undecidable{
       false}; // to mark whether we have encountered undecidable formula
 
-  for (decltype(queue)::size_type i = 0; i < queue.size(); ++i) {
-    Theory &theory = queue[i];
+  // reused by every rule application
+  std::vector<Theory> theories;
+  while (!frontier.Empty()) {
+    if (options.Cancelled()) {
+      return TableauOutput{TableauResult::kUndecidable, stats};
+    }
+    stats.peak_frontier = std::max(stats.peak_frontier, frontier.Size());
+    Theory theory = frontier.Pop();
 
-    std::vector theories = theory.TryExpand();
+    theory.TryExpand(options, stats, theories);
     if (theory.Undecidable()) {
       undecidable = true;
       continue;
@@ -396,16 +1064,127 @@ auto Tableau::Solve(const Parser::ParserOutput &parser_out) -> TableauResult {
     // to the queue is not closed, and TryExpand will not yield
     // close state.
     if (theories.empty()) {
-      return TableauResult::kSatisfiable;
+      return TableauOutput{TableauResult::kSatisfiable, stats};
+    }
+
+    for (auto &new_theory : theories) {
+      if (new_theory.Close()) {
+        ++stats.branches_closed;
+      } else {
+        frontier.Push(std::move(new_theory));
+      }
+    }
+  }
+
+  if (!undecidable) {
+    return TableauOutput{TableauResult::kUnsatisfiable, stats};
+  }
+
+  // The ground tableau ran out of constants, but a small model may exist
+  if (options.model_finding_size != 0 && !options.Cancelled() &&
+      parser_out.Result() == Parser::ParseResult::kPredicate) {
+    stats.model_size = ModelFinder::FindModel(
+        parser_out.GetFormula(), options.model_finding_size, stats);
+    if (stats.model_size != 0) {
+      return TableauOutput{TableauResult::kSatisfiable, stats};
+    }
+  }
+
+  return TableauOutput{TableauResult::kUndecidable, stats};
+}
+
+auto IncrementalTableau::Push() -> void {
+  Flush(levels_.back());
+  const AllocationScope allocation_scope{
+      AllocationProfiler::Phase::kTheoryCopy};
+  levels_.push_back(levels_.back());
+  stats_.theory_copies += levels_.back().frontier.size() +
+                          levels_.back().undecidable.size();
+}
+
+auto IncrementalTableau::Pop() -> void {
+  if (levels_.size() > 1) {
+    levels_.pop_back();
+  }
+}
+
+auto IncrementalTableau::Assert(const Formula &formula) -> void {
+  levels_.back().pending.emplace_back(formula.FlattenConnectives());
+}
+
+// Append the pending formulas to every open theory of the level, drop the
+// theories that are closed by them, and give the undecidable theories that
+// have new formulas to expand back to the frontier
+auto IncrementalTableau::Flush(Level &level) -> void {
+  if (level.pending.empty()) {
+    return;
+  }
+
+  std::vector<Theory> frontier;
+  std::vector<Theory> undecidable;
+  frontier.reserve(level.frontier.size() + level.undecidable.size());
+  undecidable.reserve(level.undecidable.size());
+  for (auto *theories : {&level.frontier, &level.undecidable}) {
+    for (auto &theory : *theories) {
+      bool extended{false};
+      for (const auto &formula : level.pending) {
+        extended = theory.Append(formula) || extended;
+      }
+      if (theory.Close()) {
+        ++stats_.branches_closed;
+      } else if (theories == &level.undecidable && !extended) {
+        undecidable.push_back(std::move(theory));
+      } else {
+        frontier.push_back(std::move(theory));
+      }
+    }
+  }
+  level.frontier = std::move(frontier);
+  level.undecidable = std::move(undecidable);
+
+  level.pending.clear();
+}
+
+/*
+  Same search as Tableau::Solve, except that nothing is thrown away
+
+  When a saturated theory is found, the theories that are not expanded yet
+  are kept together with it, so the next Check (possibly after more
+  assertions) continues from this frontier instead of the original formulas.
+*/
+auto IncrementalTableau::Check() -> Tableau::TableauResult {
+  auto &level = levels_.back();
+  Flush(level);
+
+  auto &frontier = level.frontier;
+  std::vector<Theory> theories;
+  for (decltype(level.frontier)::size_type i = 0; i < frontier.size(); ++i) {
+    stats_.peak_frontier =
+        std::max<uint64_t>(stats_.peak_frontier, frontier.size() - i);
+    frontier[i].TryExpand(options_, stats_, theories);
+
+    // An undecidable theory may still be expanded (see Flush), in which case
+    // its branches are undecidable too
+    if (theories.empty()) {
+      if (frontier[i].Undecidable()) {
+        level.undecidable.push_back(std::move(frontier[i]));
+        continue;
+      }
+      frontier.erase(frontier.begin(),
+                     frontier.begin() + static_cast<std::ptrdiff_t>(i));
+      return Tableau::TableauResult::kSatisfiable;
     }
 
     for (auto &new_theory : theories) {
-      if (!new_theory.Close()) {
-        queue.push_back(std::move(new_theory));
+      if (new_theory.Close()) {
+        ++stats_.branches_closed;
+      } else {
+        frontier.push_back(std::move(new_theory));
       }
     }
   }
 
-  return undecidable ? TableauResult::kUndecidable
-                     : TableauResult::kUnsatisfiable;
+  frontier.clear();
+  return level.undecidable.empty() ? Tableau::TableauResult::kUnsatisfiable
+                                   : Tableau::TableauResult::kUndecidable;
 }
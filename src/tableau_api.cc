@@ -0,0 +1,268 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+
+#include "parser.hh"
+#include "tableau.hh"
+#include "tableau_api.h"
+
+struct tableau_formula {
+  Parser::ParserOutput output;
+  // the memory belongs to an arena => only destroy the object
+  bool in_arena;
+};
+
+struct tableau_parser {
+  Parser::Stream stream;
+  // a chunk could not be fed
+  bool failed;
+};
+
+struct tableau_arena {
+  std::size_t size; // of the whole buffer
+  std::size_t used; // including the arena itself
+};
+
+namespace {
+// Aligned bump allocation in the arena, nullptr if it is full
+auto Allocate(tableau_arena *arena, std::size_t size, std::size_t alignment)
+    -> void * {
+  // NOLINTNEXTLINE(cppcoreguidelines-pro-type-reinterpret-cast)
+  auto *begin = reinterpret_cast<char *>(arena);
+  void *next = begin + arena->used;
+  auto space = arena->size - arena->used;
+  if (std::align(alignment, size, next, space) == nullptr) {
+    return nullptr;
+  }
+
+  arena->used = arena->size - space + size;
+  return next;
+}
+
+// Place the handle of output in the arena, or on the heap if it is full
+auto MakeFormula(Parser::ParserOutput output, tableau_arena *arena)
+    -> tableau_formula * {
+  void *memory = arena == nullptr ? nullptr
+                                  : Allocate(arena, sizeof(tableau_formula),
+                                             alignof(tableau_formula));
+  if (memory != nullptr) {
+    return new (memory) tableau_formula{std::move(output), true};
+  }
+  return new tableau_formula{std::move(output), false};
+}
+
+// Whether the struct of the caller (possibly built against an older header)
+// has the field at offset of size bytes
+auto HasField(const tableau_options &options, std::size_t offset,
+              std::size_t size) -> bool {
+  return options.struct_size >= offset + size;
+}
+
+#define TABLEAU_HAS_FIELD(options, field)                                      \
+  HasField(options, offsetof(tableau_options, field), sizeof((options).field))
+
+// The fields missing from the struct of the caller keep their default value
+auto ToOptions(const tableau_options &options) -> TableauOptions {
+  TableauOptions out;
+  if (TABLEAU_HAS_FIELD(options, memory_budget)) {
+    out.memory_budget = options.memory_budget;
+  }
+  if (TABLEAU_HAS_FIELD(options, semantic_branching)) {
+    out.semantic_branching = options.semantic_branching != 0;
+  }
+  if (TABLEAU_HAS_FIELD(options, propagation)) {
+    out.propagation = options.propagation != 0;
+  }
+  if (TABLEAU_HAS_FIELD(options, free_variable_depth)) {
+    out.free_variable_depth = options.free_variable_depth;
+  }
+  if (TABLEAU_HAS_FIELD(options, model_finding_size)) {
+    out.model_finding_size = options.model_finding_size;
+  }
+  if (TABLEAU_HAS_FIELD(options, batch_gamma)) {
+    out.batch_gamma = options.batch_gamma != 0;
+  }
+  if (TABLEAU_HAS_FIELD(options, reuse_constants)) {
+    out.reuse_constants = options.reuse_constants != 0;
+  }
+  if (TABLEAU_HAS_FIELD(options, depth_first)) {
+    out.depth_first = options.depth_first != 0;
+  }
+  if (TABLEAU_HAS_FIELD(options, portfolio)) {
+    out.portfolio = options.portfolio != 0;
+  }
+  return out;
+}
+} // namespace
+
+extern "C" {
+
+void tableau_options_init(tableau_options *options) {
+  const TableauOptions defaults;
+  if (TABLEAU_HAS_FIELD(*options, memory_budget)) {
+    options->memory_budget = defaults.memory_budget;
+  }
+  if (TABLEAU_HAS_FIELD(*options, semantic_branching)) {
+    options->semantic_branching = defaults.semantic_branching ? 1 : 0;
+  }
+  if (TABLEAU_HAS_FIELD(*options, propagation)) {
+    options->propagation = defaults.propagation ? 1 : 0;
+  }
+  if (TABLEAU_HAS_FIELD(*options, free_variable_depth)) {
+    options->free_variable_depth = defaults.free_variable_depth;
+  }
+  if (TABLEAU_HAS_FIELD(*options, model_finding_size)) {
+    options->model_finding_size = defaults.model_finding_size;
+  }
+  if (TABLEAU_HAS_FIELD(*options, batch_gamma)) {
+    options->batch_gamma = defaults.batch_gamma ? 1 : 0;
+  }
+  if (TABLEAU_HAS_FIELD(*options, reuse_constants)) {
+    options->reuse_constants = defaults.reuse_constants ? 1 : 0;
+  }
+  if (TABLEAU_HAS_FIELD(*options, depth_first)) {
+    options->depth_first = defaults.depth_first ? 1 : 0;
+  }
+  if (TABLEAU_HAS_FIELD(*options, portfolio)) {
+    options->portfolio = defaults.portfolio ? 1 : 0;
+  }
+}
+
+tableau_arena *tableau_arena_create(void *buffer, size_t size) {
+  void *aligned = buffer;
+  auto space = size;
+  if (std::align(alignof(tableau_arena), sizeof(tableau_arena), aligned,
+                 space) == nullptr) {
+    return nullptr;
+  }
+
+  return new (aligned) tableau_arena{space, sizeof(tableau_arena)};
+}
+
+void tableau_arena_reset(tableau_arena *arena) {
+  arena->used = sizeof(tableau_arena);
+}
+
+tableau_formula *tableau_parse(const char *text, size_t length,
+                               tableau_arena *arena) {
+  try {
+    return MakeFormula(Parser::Parse(std::string{text, length}), arena);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+tableau_parser *tableau_parser_create(int keep_text) {
+  try {
+    return new tableau_parser{Parser::Stream{keep_text != 0}, false};
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+int tableau_parser_feed(tableau_parser *parser, const char *chunk,
+                        size_t length) {
+  if (parser->failed) {
+    return 0;
+  }
+
+  try {
+    parser->stream.Feed(std::string_view{chunk, length});
+    return 1;
+  } catch (...) {
+    parser->failed = true;
+    return 0;
+  }
+}
+
+tableau_formula *tableau_parser_finish(tableau_parser *parser,
+                                       tableau_arena *arena) {
+  tableau_formula *formula{nullptr};
+  try {
+    formula = MakeFormula(
+        parser->failed ? Parser::ParserOutput{{},
+                                              {},
+                                              Parser::ParseResult::kNotAFormula}
+                       : parser->stream.Finish(),
+        arena);
+  } catch (...) {
+  }
+  delete parser;
+  return formula;
+}
+
+tableau_kind tableau_formula_kind(const tableau_formula *formula) {
+  switch (formula->output.Result()) {
+  case Parser::ParseResult::kNotAFormula:
+    return TABLEAU_NOT_A_FORMULA;
+  case Parser::ParseResult::kProposition:
+    return TABLEAU_PROPOSITION;
+  case Parser::ParseResult::kPredicate:
+    return TABLEAU_PREDICATE;
+  }
+  return TABLEAU_NOT_A_FORMULA;
+}
+
+tableau_result tableau_solve(const tableau_formula *formula,
+                             const tableau_options *options) {
+  if (formula->output.Result() == Parser::ParseResult::kNotAFormula ||
+      (options != nullptr && !TABLEAU_HAS_FIELD(*options, memory_budget))) {
+    return TABLEAU_ERROR;
+  }
+
+  try {
+    const auto result =
+        Tableau::Solve(formula->output, options == nullptr
+                                            ? TableauOptions{}
+                                            : ToOptions(*options))
+            .Result();
+    switch (result) {
+    case Tableau::TableauResult::kUnsatisfiable:
+      return TABLEAU_UNSATISFIABLE;
+    case Tableau::TableauResult::kSatisfiable:
+      return TABLEAU_SATISFIABLE;
+    case Tableau::TableauResult::kUndecidable:
+      return TABLEAU_UNDECIDABLE;
+    }
+  } catch (...) {
+  }
+  return TABLEAU_ERROR;
+}
+
+size_t tableau_describe(const tableau_formula *formula, char *buffer,
+                        size_t size) {
+  try {
+    const auto description =
+        formula->output.Result() == Parser::ParseResult::kNotAFormula
+            ? formula->output.RawFormula()
+            : formula->output.GetFormula().Description();
+
+    if (size > 0) {
+      const auto copied = std::min(description.size(), size - 1);
+      std::memcpy(buffer, description.data(), copied);
+      buffer[copied] = '\0';
+    }
+    return description.size();
+  } catch (...) {
+    if (size > 0) {
+      buffer[0] = '\0';
+    }
+    return 0;
+  }
+}
+
+void tableau_free(tableau_formula *formula) {
+  if (formula == nullptr) {
+    return;
+  }
+
+  if (formula->in_arena) {
+    formula->~tableau_formula();
+  } else {
+    delete formula;
+  }
+}
+}
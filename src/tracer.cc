@@ -0,0 +1,103 @@
+#include <atomic>
+#include <utility>
+
+#include "tracer.hh"
+
+namespace {
+// spans currently recorded on this thread
+thread_local uint64_t depth{0};
+// sampled spans seen on this thread
+thread_local uint64_t samples{0};
+
+auto ThreadId() -> uint64_t {
+  static std::atomic<uint64_t> next_id{0};
+  thread_local const uint64_t id{next_id++};
+  return id;
+}
+
+auto Microseconds(std::chrono::steady_clock::duration duration) -> double {
+  return std::chrono::duration<double, std::micro>(duration).count();
+}
+
+// JSON string contents: quotes, backslashes and control characters escaped
+auto EscapeString(const std::string &value) -> std::string {
+  static constexpr char kHex[]{"0123456789abcdef"};
+  std::string out;
+  out.reserve(value.size());
+  for (const char c : value) {
+    const auto code = static_cast<unsigned char>(c);
+    if (c == '"' || c == '\\') {
+      out += '\\';
+      out += c;
+    } else if (code < 0x20U) {
+      out += "\\u00";
+      out += kHex[code >> 4U];
+      out += kHex[code & 0xfU];
+    } else {
+      out += c;
+    }
+  }
+  return out;
+}
+} // namespace
+
+auto Tracer::Record(const char *name,
+                    std::chrono::steady_clock::time_point start,
+                    std::chrono::steady_clock::time_point end,
+                    std::string args) -> void {
+  Event event{name, Microseconds(start - epoch_), Microseconds(end - start),
+              ThreadId(), std::move(args)};
+  const std::lock_guard lock{mutex_};
+  events_.push_back(std::move(event));
+}
+
+auto Tracer::Write(std::ostream &out) const -> void {
+  const std::lock_guard lock{mutex_};
+  out << "{\"traceEvents\":[";
+  for (decltype(events_)::size_type i = 0; i < events_.size(); ++i) {
+    const auto &event = events_[i];
+    out << (i == 0 ? "" : ",\n") << "{\"name\":\"" << event.name
+        << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.thread_id
+        << ",\"ts\":" << event.timestamp << ",\"dur\":" << event.duration
+        << ",\"args\":{" << event.args << "}}";
+  }
+  out << "]}\n";
+}
+
+auto TraceSpan::Begin(bool sampled) -> void {
+  if (depth >= tracer_->MaxDepth() ||
+      (sampled && samples++ % tracer_->SampleEvery() != 0)) {
+    tracer_ = nullptr;
+    return;
+  }
+  ++depth;
+  start_ = std::chrono::steady_clock::now();
+}
+
+TraceSpan::~TraceSpan() {
+  if (tracer_ == nullptr) {
+    return;
+  }
+  --depth;
+  tracer_->Record(name_, start_, std::chrono::steady_clock::now(),
+                  std::move(args_));
+}
+
+auto TraceSpan::AddArgument(const char *key, const std::string &value)
+    -> void {
+  if (tracer_ == nullptr) {
+    return;
+  }
+  args_ += args_.empty() ? "\"" : ",\"";
+  args_ += key;
+  args_ += "\":\"" + EscapeString(value) + "\"";
+}
+
+auto TraceSpan::AddArgument(const char *key, uint64_t value) -> void {
+  if (tracer_ == nullptr) {
+    return;
+  }
+  args_ += args_.empty() ? "\"" : ",\"";
+  args_ += key;
+  args_ += "\":" + std::to_string(value);
+}
@@ -0,0 +1,43 @@
+#include <cerrno>
+#include <charconv>
+#include <iterator>
+#include <utility>
+
+#include <unistd.h>
+
+#include "writer.hh"
+
+Writer::~Writer() { Flush(); }
+
+auto Writer::operator<<(uint64_t value) -> Writer & {
+  char digits[20];
+  const auto result =
+      std::to_chars(std::begin(digits), std::end(digits), value);
+  buffer_.append(std::begin(digits), result.ptr);
+  return *this;
+}
+
+auto Writer::Flush() -> bool {
+  if (fd_ < 0) {
+    return good_;
+  }
+
+  std::string_view pending{buffer_};
+  while (good_ && !pending.empty()) {
+    const auto written = ::write(fd_, pending.data(), pending.size());
+    if (written < 0) {
+      good_ = errno == EINTR;
+      continue;
+    }
+    pending.remove_prefix(static_cast<std::size_t>(written));
+  }
+
+  buffer_.clear();
+  return good_;
+}
+
+auto Writer::Take() -> std::string {
+  auto out = std::move(buffer_);
+  buffer_.clear();
+  return out;
+}
@@ -0,0 +1,123 @@
+#!/bin/sh
+# Compare the output of every case below with tests/expected/NAME.txt
+# Usage: tests/run.sh PROGRAM, e.g. make release=1 test runs
+#   tests/run.sh bin/release/src/main.out
+# Run it with UPDATE=1 to write the expected outputs instead.
+
+if [ $# -ne 1 ]; then
+  echo "Usage: $0 PROGRAM" >&2
+  exit 2
+fi
+
+program=$1
+tests=$(dirname "$0")
+failures=0
+
+# compare NAME STDIN COMMAND...: the standard output of COMMAND < STDIN
+# with the expected one of NAME
+compare() {
+  name=$1
+  stdin=$2
+  shift 2
+  expected="$tests/expected/$name.txt"
+  if [ "${UPDATE:-0}" = 1 ]; then
+    "$@" <"$stdin" >"$expected"
+    return
+  fi
+  if "$@" <"$stdin" | diff -u "$expected" - >/dev/null; then
+    echo "ok   $name"
+  else
+    echo "FAIL $name: $* < $stdin"
+    failures=$((failures + 1))
+  fi
+}
+
+# check NAME INPUT [OPTIONS...]: PROGRAM [OPTIONS...] INPUT
+check() {
+  name=$1
+  input=$2
+  shift 2
+  compare "$name" /dev/null "$program" "$@" "$tests/$input"
+}
+
+# counters NAME INPUT [OPTIONS...]: the --stats records of
+# PROGRAM [OPTIONS...] INPUT, without the timings
+counters() {
+  name=$1
+  input=$2
+  shift 2
+  compare "$name" /dev/null without_timings "$program" --stats "$@" \
+    "$tests/$input"
+}
+
+# counters_within SECONDS NAME INPUT [OPTIONS...]: counters, but failing
+# when PROGRAM takes more than SECONDS
+counters_within() {
+  seconds=$1
+  name=$2
+  input=$3
+  shift 3
+  compare "$name" /dev/null without_timings timeout "$seconds" "$program" \
+    --stats "$@" "$tests/$input"
+}
+
+without_timings() {
+  "$@" 2>&1 >/dev/null | sed -e 's/"ns":[0-9]*,//g' -e 's/,"ns":[0-9]*//g'
+}
+
+# serve NAME REQUESTS [OPTIONS...]: PROGRAM --serve=- [OPTIONS...] < REQUESTS
+serve() {
+  name=$1
+  requests=$2
+  shift 2
+  compare "$name" "$tests/$requests" "$program" --serve=- "$@"
+}
+
+# The inputs of tests
+check custom custom.txt
+check prop-custom-1 prop-custom-1.txt
+check prop-custom-2-unsat prop-custom-2-unsat.txt
+check prop-custom-3-sat prop-custom-3-sat.txt
+check pred-custom-1 pred-custom-1.txt
+check pred-custom-2-unsat pred-custom-2-unsat.txt
+check pred-custom-3-sat pred-custom-3-sat.txt
+# the last formula is satisfiable: ExQ(x,x) is not expanded again on a
+# branch where it is already queued, so the branches end before running out
+# of constants
+check pred-custom-4-may pred-custom-4-may.txt
+check pred-custom-5-uncertain pred-custom-5-uncertain.txt
+
+# 100000 negations: walking the chain again at every step takes minutes
+counters_within 15 deep-negation deep-negation.txt
+
+# Chains of ^ and v are expanded in one step (n-ary connectives)
+counters chains chains.txt
+
+# Same results for every beta strategy, with fewer branches
+counters branching branching.txt
+counters branching-semantic branching.txt --semantic-branching
+counters branching-propagation branching.txt --propagation
+counters branching-semantic-propagation branching.txt --semantic-branching \
+  --propagation
+check branching-portfolio branching.txt --portfolio
+check branching-memory-budget branching.txt --memory-budget=1
+
+# The tableau allows an empty domain, so Ax(P(x,x)^-P(x,x)) is satisfiable,
+# with or without the free-variable tableau
+counters first-order first-order.txt
+counters first-order-free-variables first-order.txt --free-variables=2
+counters first-order-model-finding first-order.txt --model-finding=2
+counters first-order-batch-gamma first-order.txt --batch-gamma
+counters first-order-reuse-constants first-order.txt --reuse-constants
+check first-order-portfolio first-order.txt --portfolio
+
+# PUSH/ASSERT/POP/CHECK on the incremental solver of the connection
+serve incremental incremental.txt
+serve incremental-jobs incremental.txt --jobs=4
+# An undecidable theory is expanded again when new formulas are asserted
+serve incremental-undecidable incremental-undecidable.txt
+
+if [ "$failures" -ne 0 ]; then
+  echo "$failures case(s) failed"
+  exit 1
+fi
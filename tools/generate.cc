@@ -0,0 +1,443 @@
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+/*
+  Generator of input files (with the "PARSE SAT" header) for stress and
+  scaling tests
+
+  Every family is parameterized by a size, and the output only depends on
+  the options (the random numbers come from splitmix64, not from the
+  standard library whose distributions differ between implementations).
+
+  The language only has 4 propositions (p, q, r, s). The other atoms are
+  predicates over free variables (P(x,y), ...), which the tableau treats
+  as opaque literals, so the propositional families have at most kAtoms
+  atoms. The parser rejects formulas that mix both, so a formula only uses
+  propositions if it needs at most 4 atoms.
+*/
+
+namespace {
+// p, q, r, s, then P(x,x), P(x,y), ..., S(w,w)
+constexpr uint64_t kPropositions{4};
+constexpr std::string_view kPropositionNames{"pqrs"};
+constexpr std::string_view kPredicateNames{"PQRS"};
+constexpr std::string_view kVariableNames{"xyzw"};
+constexpr uint64_t kAtoms{4 * 4 * 4};
+
+// splitmix64
+class Random {
+public:
+  explicit Random(uint64_t seed) : state_{seed} {}
+
+  auto Next() -> uint64_t {
+    state_ += 0x9e3779b97f4a7c15ULL;
+    uint64_t z = state_;
+    z = (z ^ (z >> 30U)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27U)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31U);
+  }
+
+  // Uniform in [0, bound), bound > 0
+  auto Below(uint64_t bound) -> uint64_t {
+    // reject the last partial range so that every value is equally likely
+    const uint64_t limit = UINT64_MAX - UINT64_MAX % bound;
+    uint64_t value = Next();
+    while (value >= limit) {
+      value = Next();
+    }
+    return value % bound;
+  }
+
+  auto Coin() -> bool { return (Next() >> 63U) != 0; }
+
+  template <typename T> auto Shuffle(std::vector<T> &values) -> void {
+    for (auto i = values.size(); i > 1; --i) {
+      std::swap(values[i - 1], values[Below(i)]);
+    }
+  }
+
+private:
+  uint64_t state_;
+};
+
+auto Atom(uint64_t index) -> std::string {
+  if (index < kPropositions) {
+    return std::string(1, kPropositionNames[index]);
+  }
+  index -= kPropositions;
+  std::string atom(1, kPredicateNames[index / 16]);
+  atom += '(';
+  atom += kVariableNames[index / 4 % 4];
+  atom += ',';
+  atom += kVariableNames[index % 4];
+  atom += ')';
+  return atom;
+}
+
+auto Literal(uint64_t index, bool negated) -> std::string {
+  return negated ? "-" + Atom(index) : Atom(index);
+}
+
+// A random mapping from the atoms of a family (needed of them) to the atoms
+// of the language, so that the lines of a file differ
+auto Atoms(uint64_t needed, Random &random) -> std::vector<uint64_t> {
+  const auto first = needed <= kPropositions ? 0 : kPropositions;
+  const auto count = needed <= kPropositions ? kPropositions : kAtoms;
+  std::vector<uint64_t> atoms(count);
+  for (uint64_t i = 0; i < count; ++i) {
+    atoms[i] = first + i;
+  }
+  random.Shuffle(atoms);
+  return atoms;
+}
+
+// Balanced tree of the operands with the connective (the tree is not
+// nested deeper than log2 of the number of operands)
+auto Join(std::vector<std::string> operands, char connective) -> std::string {
+  if (operands.empty()) {
+    return {};
+  }
+
+  while (operands.size() > 1) {
+    std::vector<std::string> joined;
+    joined.reserve((operands.size() + 1) / 2);
+    for (std::size_t i = 0; i + 1 < operands.size(); i += 2) {
+      joined.push_back("(" + operands[i] + connective + operands[i + 1] + ")");
+    }
+    if (operands.size() % 2 == 1) {
+      joined.push_back(std::move(operands.back()));
+    }
+    operands = std::move(joined);
+  }
+  return std::move(operands.front());
+}
+
+struct Options {
+  std::string family{};
+  uint64_t size{0};
+  uint64_t max_size{0};
+  uint64_t step{1};
+  uint64_t count{1};
+  uint64_t seed{1};
+  uint64_t k{3};
+  uint64_t clauses{0};
+  uint64_t alternations{0};
+};
+
+/*
+  Random k-CNF over size atoms
+  The default number of clauses is at the satisfiability threshold of
+  random k-SAT, where formulas are the hardest
+*/
+auto RandomCnf(const Options &options, uint64_t size, Random &random)
+    -> std::string {
+  // ratio clauses/atoms * 100 at the threshold, for k = 1..5
+  constexpr std::array<uint64_t, 6> kThreshold{0, 100, 100, 426, 993, 2112};
+  const auto clauses =
+      options.clauses != 0
+          ? options.clauses
+          : std::max<uint64_t>(1, (size * kThreshold.at(options.k) + 50) / 100);
+
+  const auto atoms = Atoms(size, random);
+  std::vector<std::string> conjuncts;
+  conjuncts.reserve(clauses);
+  for (uint64_t i = 0; i < clauses; ++i) {
+    // k distinct atoms among size
+    std::vector<uint64_t> chosen;
+    while (chosen.size() < options.k) {
+      const auto atom = random.Below(size);
+      if (std::find(chosen.begin(), chosen.end(), atom) == chosen.end()) {
+        chosen.push_back(atom);
+      }
+    }
+
+    std::vector<std::string> disjuncts;
+    disjuncts.reserve(options.k);
+    for (const auto atom : chosen) {
+      disjuncts.push_back(Literal(atoms[atom], random.Coin()));
+    }
+    conjuncts.push_back(Join(std::move(disjuncts), 'v'));
+  }
+  return Join(std::move(conjuncts), '^');
+}
+
+// size + 1 pigeons in size holes (unsatisfiable)
+auto Pigeonhole(uint64_t size, Random &random) -> std::string {
+  const auto atoms = Atoms((size + 1) * size, random);
+  // pigeon i is in hole j
+  const auto in = [&](uint64_t i, uint64_t j) { return atoms[i * size + j]; };
+
+  std::vector<std::string> conjuncts;
+  for (uint64_t i = 0; i <= size; ++i) {
+    std::vector<std::string> holes;
+    for (uint64_t j = 0; j < size; ++j) {
+      holes.push_back(Literal(in(i, j), false));
+    }
+    conjuncts.push_back(Join(std::move(holes), 'v'));
+  }
+  for (uint64_t j = 0; j < size; ++j) {
+    for (uint64_t i = 0; i <= size; ++i) {
+      for (uint64_t other = i + 1; other <= size; ++other) {
+        conjuncts.push_back("(" + Literal(in(i, j), true) + "v" +
+                            Literal(in(other, j), true) + ")");
+      }
+    }
+  }
+  random.Shuffle(conjuncts);
+  return Join(std::move(conjuncts), '^');
+}
+
+/*
+  The parity of size atoms computed by two chains of xor in opposite
+  orders, whose outputs are asserted to differ (unsatisfiable)
+  Every xor t = a + b is the 4 clauses of its truth table, so the formula
+  is linear in size, but refuting it needs reasoning about the whole chain.
+*/
+auto ParityChain(uint64_t size, Random &random) -> std::string {
+  const auto atoms = Atoms(3 * size - 2, random);
+  uint64_t next{size};
+
+  std::vector<std::string> conjuncts;
+  const auto xor_clauses = [&](uint64_t t, uint64_t a, uint64_t b) {
+    for (const auto &[not_t, not_a, not_b] :
+         {std::array{true, false, false}, std::array{true, true, true},
+          std::array{false, true, false}, std::array{false, false, true}}) {
+      conjuncts.push_back(Join({Literal(atoms[t], not_t),
+                                Literal(atoms[a], not_a),
+                                Literal(atoms[b], not_b)},
+                               'v'));
+    }
+  };
+  const auto chain = [&](bool reversed) {
+    const auto input = [&](uint64_t i) {
+      return reversed ? size - 1 - i : i;
+    };
+    uint64_t out = input(0);
+    for (uint64_t i = 1; i < size; ++i) {
+      xor_clauses(next, out, input(i));
+      out = next++;
+    }
+    return out;
+  };
+
+  const auto forward = chain(false);
+  const auto backward = chain(true);
+  random.Shuffle(conjuncts);
+  conjuncts.push_back(Literal(atoms[forward], false));
+  conjuncts.push_back(Literal(atoms[backward], true));
+  return Join(std::move(conjuncts), '^');
+}
+
+// size implications nested on random sides: (A>l) or (l>A)
+auto NestedImplications(uint64_t size, Random &random) -> std::string {
+  const auto atoms = Atoms(size + 1, random);
+  const auto literal = [&] {
+    return Literal(atoms[random.Below(atoms.size())], random.Coin());
+  };
+
+  std::string formula = literal();
+  for (uint64_t i = 0; i < size; ++i) {
+    formula = random.Coin() ? "(" + formula + ">" + literal() + ")"
+                            : "(" + literal() + ">" + formula + ")";
+  }
+  return formula;
+}
+
+// Conjunction of size random literals
+auto WideConjunction(uint64_t size, Random &random) -> std::string {
+  const auto atoms = Atoms(size, random);
+  std::vector<std::string> conjuncts;
+  conjuncts.reserve(size);
+  for (uint64_t i = 0; i < size; ++i) {
+    conjuncts.push_back(
+        Literal(atoms[random.Below(atoms.size())], random.Coin()));
+  }
+  return Join(std::move(conjuncts), '^');
+}
+
+/*
+  A prefix of size quantifiers, split into alternations + 1 blocks of the
+  same quantifier, over a random matrix in CNF of binary clauses
+  The quantifiers bind x, y, z, w in turn (the inner ones shadow the outer
+  ones from the fifth on), and the matrix only uses bound variables.
+*/
+auto FirstOrder(const Options &options, uint64_t size, Random &random)
+    -> std::string {
+  const auto alternations = std::min(options.alternations, size - 1);
+  const auto clauses = options.clauses != 0 ? options.clauses : size;
+  const auto variables = std::min<uint64_t>(size, kVariableNames.size());
+
+  std::string prefix;
+  bool universal = random.Coin();
+  for (uint64_t i = 0; i < size; ++i) {
+    // the block of quantifier i
+    if (i > 0 && i * (alternations + 1) / size !=
+                     (i - 1) * (alternations + 1) / size) {
+      universal = !universal;
+    }
+    prefix += universal ? 'A' : 'E';
+    prefix += kVariableNames[i % kVariableNames.size()];
+  }
+
+  const auto variable = [&] {
+    return kVariableNames[random.Below(variables)];
+  };
+  const auto literal = [&] {
+    std::string atom(1, kPredicateNames[random.Below(4)]);
+    atom += '(';
+    atom += variable();
+    atom += ',';
+    atom += variable();
+    atom += ')';
+    return random.Coin() ? "-" + atom : atom;
+  };
+
+  std::vector<std::string> conjuncts;
+  conjuncts.reserve(clauses);
+  for (uint64_t i = 0; i < clauses; ++i) {
+    conjuncts.push_back("(" + literal() + "v" + literal() + ")");
+  }
+  return prefix + Join(std::move(conjuncts), '^');
+}
+
+// Return an error message, empty if the size is valid for the family
+auto CheckSize(const Options &options, uint64_t size) -> std::string {
+  if (size == 0) {
+    return "The size must be positive";
+  }
+  if (options.family == "cnf" &&
+      (size > kAtoms || options.k == 0 || options.k > 5 || options.k > size)) {
+    return "cnf needs 1 <= k <= 5, k <= size and size <= " +
+           std::to_string(kAtoms);
+  }
+  if (options.family == "pigeonhole" && (size + 1) * size > kAtoms) {
+    return "pigeonhole needs (size + 1) * size <= " + std::to_string(kAtoms);
+  }
+  if (options.family == "parity" && (size < 2 || 3 * size - 2 > kAtoms)) {
+    return "parity needs 2 <= size and 3 * size - 2 <= " +
+           std::to_string(kAtoms);
+  }
+  return {};
+}
+
+auto Generate(const Options &options, uint64_t size, Random &random)
+    -> std::string {
+  if (options.family == "cnf") {
+    return RandomCnf(options, size, random);
+  }
+  if (options.family == "pigeonhole") {
+    return Pigeonhole(size, random);
+  }
+  if (options.family == "parity") {
+    return ParityChain(size, random);
+  }
+  if (options.family == "implications") {
+    return NestedImplications(size, random);
+  }
+  if (options.family == "wide") {
+    return WideConjunction(size, random);
+  }
+  return FirstOrder(options, size, random);
+}
+
+// Parse "--name=value" into value
+// Return false if arg is not this option
+auto ParseOption(std::string_view arg, std::string_view name, uint64_t &value)
+    -> bool {
+  if (arg.substr(0, name.size()) != name) {
+    return false;
+  }
+  arg.remove_prefix(name.size());
+  const auto *const end = arg.data() + arg.size();
+  const auto [ptr, ec] = std::from_chars(arg.data(), end, value);
+  return ec == std::errc{} && ptr == end && !arg.empty();
+}
+
+auto ParseOption(std::string_view arg, std::string_view name,
+                 std::string &value) -> bool {
+  if (arg.substr(0, name.size()) != name) {
+    return false;
+  }
+  value = arg.substr(name.size());
+  return true;
+}
+
+auto PrintUsage(std::ostream &out, const char *program) -> void {
+  out << "Usage: " << program
+      << " --family=FAMILY --size=N [options] > FILE\n"
+         "Families:\n"
+         "  cnf           random k-CNF over N atoms\n"
+         "  pigeonhole    N + 1 pigeons in N holes\n"
+         "  parity        two xor chains over N atoms that disagree\n"
+         "  implications  N implications nested on random sides\n"
+         "  wide          conjunction of N random literals\n"
+         "  fol           N nested quantifiers over a random matrix\n"
+         "Options:\n"
+         "  --max-size=N      one size from --size to N (by --step=N)\n"
+         "  --count=N         formulas per size (1 by default)\n"
+         "  --seed=N          seed of the random numbers (1 by default)\n"
+         "  --k=N             literals per clause of cnf (3 by default)\n"
+         "  --clauses=N       clauses of cnf and fol (cnf: at the "
+         "threshold,\n"
+         "                    fol: N by default)\n"
+         "  --alternations=N  quantifier alternations of fol (0 by "
+         "default)\n";
+}
+} // namespace
+
+auto main(int argc, char *argv[]) -> int {
+  Options options;
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view arg{argv[i]};
+    if (!ParseOption(arg, "--family=", options.family) &&
+        !ParseOption(arg, "--size=", options.size) &&
+        !ParseOption(arg, "--max-size=", options.max_size) &&
+        !ParseOption(arg, "--step=", options.step) &&
+        !ParseOption(arg, "--count=", options.count) &&
+        !ParseOption(arg, "--seed=", options.seed) &&
+        !ParseOption(arg, "--k=", options.k) &&
+        !ParseOption(arg, "--clauses=", options.clauses) &&
+        !ParseOption(arg, "--alternations=", options.alternations)) {
+      std::cerr << "Unknown option " << arg << "\n";
+      PrintUsage(std::cerr, argv[0]);
+      return 1;
+    }
+  }
+
+  constexpr std::array kFamilies{"cnf",          "pigeonhole", "parity",
+                                 "implications", "wide",       "fol"};
+  if (std::find(kFamilies.begin(), kFamilies.end(), options.family) ==
+      kFamilies.end()) {
+    PrintUsage(options.family.empty() ? std::cout : std::cerr, argv[0]);
+    return options.family.empty() ? 0 : 1;
+  }
+  options.max_size = std::max(options.max_size, options.size);
+  options.step = std::max<uint64_t>(options.step, 1);
+
+  for (auto size = options.size; size <= options.max_size;
+       size += options.step) {
+    const auto error = CheckSize(options, size);
+    if (!error.empty()) {
+      std::cerr << error << " (size " << size << ")\n";
+      return 1;
+    }
+  }
+
+  std::ios::sync_with_stdio(false);
+  std::cout << "PARSE SAT\n";
+  Random random{options.seed};
+  for (auto size = options.size; size <= options.max_size;
+       size += options.step) {
+    for (uint64_t i = 0; i < options.count; ++i) {
+      std::cout << Generate(options, size, random) << "\n";
+    }
+  }
+  return std::cout ? 0 : 1;
+}